@@ -0,0 +1,139 @@
+#include "common/epollselect.h"
+
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <system_error>
+
+using namespace std;
+
+namespace swss {
+
+/* Maximum number of events fetched by one epoll_wait call */
+#define EPOLL_MAX_EVENTS 64
+
+EpollSelect::EpollSelect()
+{
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epfd < 0)
+        throw system_error(errno, system_category(), "epoll_create1");
+}
+
+EpollSelect::~EpollSelect()
+{
+    close(m_epfd);
+}
+
+void EpollSelect::addSelectable(Selectable *selectable)
+{
+    if (m_objects.find(selectable) != m_objects.end())
+        return;
+
+    /* Selectable only exposes its descriptors through an fd_set */
+    fd_set fds;
+    FD_ZERO(&fds);
+    selectable->addFd(&fds);
+
+    vector<int> &selectable_fds = m_objects[selectable];
+    for (int fd = 0; fd < FD_SETSIZE; fd++)
+    {
+        if (!FD_ISSET(fd, &fds))
+            continue;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+
+        if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            throw system_error(errno, system_category(), "epoll_ctl");
+
+        m_fds[fd] = selectable;
+        selectable_fds.push_back(fd);
+    }
+
+    /* Data may already be cached before the first wakeup */
+    m_ready.push_back(selectable);
+}
+
+void EpollSelect::removeSelectable(Selectable *selectable)
+{
+    auto it = m_objects.find(selectable);
+    if (it == m_objects.end())
+        return;
+
+    for (int fd : it->second)
+    {
+        /* The descriptor may already be closed by the selectable */
+        epoll_ctl(m_epfd, EPOLL_CTL_DEL, fd, NULL);
+        m_fds.erase(fd);
+        m_events.erase(remove(m_events.begin(), m_events.end(), fd), m_events.end());
+    }
+
+    m_ready.erase(remove(m_ready.begin(), m_ready.end(), selectable), m_ready.end());
+    m_objects.erase(it);
+}
+
+int EpollSelect::select(Selectable **c, int *fd, unsigned int timeout)
+{
+    *fd = 0;
+
+    /* Drain the data cached by the selectables dispatched previously */
+    while (!m_ready.empty())
+    {
+        Selectable *selectable = m_ready.front();
+
+        int ret = selectable->readCache();
+        if (ret == Selectable::DATA)
+        {
+            *c = selectable;
+            return OBJECT;
+        }
+
+        m_ready.pop_front();
+        if (ret == Selectable::ERROR)
+            return ERROR;
+    }
+
+    if (m_events.empty())
+    {
+        struct epoll_event events[EPOLL_MAX_EVENTS];
+        int epoll_timeout = timeout == numeric_limits<unsigned int>::max() ?
+                -1 : (int)min<unsigned int>(timeout, numeric_limits<int>::max());
+
+        int ret;
+        do
+        {
+            ret = epoll_wait(m_epfd, events, EPOLL_MAX_EVENTS, epoll_timeout);
+        }
+        while (ret < 0 && errno == EINTR);
+
+        if (ret < 0)
+            return ERROR;
+
+        if (ret == 0)
+            return TIMEOUT;
+
+        for (int i = 0; i < ret; i++)
+            m_events.push_back(events[i].data.fd);
+    }
+
+    int ready_fd = m_events.front();
+    m_events.pop_front();
+
+    Selectable *selectable = m_fds[ready_fd];
+    selectable->readMe();
+
+    /* readMe() may have removed the selectable */
+    if (m_objects.find(selectable) != m_objects.end())
+        m_ready.push_back(selectable);
+
+    *c = selectable;
+    *fd = ready_fd;
+    return OBJECT;
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef SWSS_EPOLLSELECT_H
+#define SWSS_EPOLLSELECT_H
+
+#include "selectable.h"
+
+#include <deque>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace swss {
+
+/*
+ * EpollSelect is a drop-in replacement of Select built on epoll. The
+ * file descriptors of a selectable are registered once, so a wakeup only
+ * costs the selectables that are ready instead of every registered one.
+ *
+ * The Selectable contract only allows one readMe() per wakeup, which may
+ * leave data in the descriptor or in the selectable's own cache. The
+ * descriptors are therefore watched level-triggered: edge-triggered
+ * readiness would never report the data left by a partial readMe() again.
+ * The selectables returned by the last calls are kept on a ready list and
+ * their readCache() is checked before waiting again.
+ */
+class EpollSelect
+{
+public:
+    EpollSelect();
+    ~EpollSelect();
+
+    /* Add a selectable, its file descriptors are probed through addFd() */
+    void addSelectable(Selectable *selectable);
+    /* Remove a selectable, safe to call while dispatching one of them */
+    void removeSelectable(Selectable *selectable);
+
+    enum {
+        OBJECT = 0,
+        ERROR = 1,
+        TIMEOUT = 2
+    };
+
+    /* Wait up to timeout milliseconds for a selectable to have data */
+    int select(Selectable **c, int *fd,
+               unsigned int timeout = std::numeric_limits<unsigned int>::max());
+
+private:
+    int m_epfd;
+
+    /* Registered file descriptors and their selectable */
+    std::unordered_map<int, Selectable *> m_fds;
+    /* Registered selectables and their file descriptors */
+    std::unordered_map<Selectable *, std::vector<int> > m_objects;
+
+    /* Selectables which may have cached data */
+    std::deque<Selectable *> m_ready;
+    /* File descriptors reported by epoll and not dispatched yet */
+    std::deque<int> m_events;
+};
+
+}
+
+#endif
@@ -0,0 +1,359 @@
+#include "common/recorder.h"
+
+#include "logger.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+namespace swss {
+
+static uint64_t nowUs()
+{
+    return chrono::duration_cast<chrono::microseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void putVarint(string &buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((char)value);
+}
+
+static void putString(string &buffer, const string &value)
+{
+    putVarint(buffer, value.size());
+    buffer.append(value);
+}
+
+Recorder &Recorder::getInstance()
+{
+    static Recorder instance;
+    return instance;
+}
+
+Recorder::Recorder() :
+    m_recording(false),
+    m_file(NULL),
+    m_lastTime(0),
+    m_lastFlush(0)
+{
+}
+
+Recorder::~Recorder()
+{
+    close();
+}
+
+bool Recorder::open(const string &file)
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    if (m_file)
+        return false;
+
+    m_file = fopen(file.c_str(), "wb");
+    if (!m_file)
+    {
+        SWSS_LOG_ERROR("Failed to open record log %s: %s\n", file.c_str(), strerror(errno));
+        return false;
+    }
+
+    m_buffer.assign(RECORD_MAGIC);
+    m_tableIds.clear();
+    m_lastTime = 0;
+    m_lastFlush = nowUs();
+    flush();
+    m_recording = true;
+
+    SWSS_LOG_NOTICE("Record tasks into %s\n", file.c_str());
+    return true;
+}
+
+void Recorder::close()
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    if (!m_file)
+        return;
+
+    m_recording = false;
+    flush();
+    fclose(m_file);
+    m_file = NULL;
+}
+
+uint32_t Recorder::getTableId(const string &table)
+{
+    auto it = m_tableIds.find(table);
+    if (it != m_tableIds.end())
+        return it->second;
+
+    uint32_t id = (uint32_t)m_tableIds.size();
+    m_tableIds[table] = id;
+
+    m_buffer.push_back(RECORD_TABLE);
+    putVarint(m_buffer, id);
+    putString(m_buffer, table);
+    return id;
+}
+
+void Recorder::flush()
+{
+    if (!m_buffer.empty())
+    {
+        if (fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size())
+            SWSS_LOG_ERROR("Failed to write record log: %s\n", strerror(errno));
+        m_buffer.clear();
+    }
+
+    fflush(m_file);
+}
+
+void Recorder::record(const string &table, const KeyOpFieldsValuesTuple &kco)
+{
+    record(table, kfvKey(kco), kfvOp(kco), kfvFieldsValues(kco));
+}
+
+void Recorder::record(const string &table, const string &key,
+                      const string &op, const vector<FieldValueTuple> &values)
+{
+    if (!isOpen())
+        return;
+
+    lock_guard<mutex> lock(m_mutex);
+
+    if (!m_file)
+        return;
+
+    uint64_t now = nowUs();
+    uint32_t id = getTableId(table);
+
+    /* The wall clock may step backward, keep the deltas positive */
+    if (now < m_lastTime)
+        now = m_lastTime;
+
+    if (op == DEL_COMMAND)
+    {
+        m_buffer.push_back(RECORD_DEL);
+        putVarint(m_buffer, now - m_lastTime);
+        putVarint(m_buffer, id);
+        putString(m_buffer, key);
+    }
+    else
+    {
+        m_buffer.push_back(RECORD_SET);
+        putVarint(m_buffer, now - m_lastTime);
+        putVarint(m_buffer, id);
+        putString(m_buffer, key);
+        putVarint(m_buffer, values.size());
+        for (auto &fv : values)
+        {
+            putString(m_buffer, fvField(fv));
+            putString(m_buffer, fvValue(fv));
+        }
+    }
+
+    m_lastTime = now;
+
+    flushIfDue(now);
+}
+
+void Recorder::poll()
+{
+    if (!isOpen())
+        return;
+
+    lock_guard<mutex> lock(m_mutex);
+
+    if (m_file)
+        flushIfDue(nowUs());
+}
+
+void Recorder::flushIfDue(uint64_t now)
+{
+    if (m_buffer.size() >= RECORD_BUFFER_SIZE || now - m_lastFlush >= RECORD_FLUSH_INTERVAL)
+    {
+        flush();
+        m_lastFlush = now;
+    }
+}
+
+void Recorder::closeOnSignal()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+
+    /*
+     * Block the signals in this thread and in the ones it starts later, so
+     * that only the thread waiting for them receives them. It takes the
+     * recorder lock to close the log, which a signal handler cannot do.
+     */
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    thread([signals]() {
+        int signum;
+        if (sigwait(&signals, &signum) != 0)
+            return;
+
+        SWSS_LOG_NOTICE("Close record log on signal %d\n", signum);
+        Recorder::getInstance().close();
+
+        signal(signum, SIG_DFL);
+        pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+        raise(signum);
+    }).detach();
+}
+
+RecordReader::RecordReader() :
+    m_file(NULL),
+    m_size(0),
+    m_corrupt(false),
+    m_lastTime(0)
+{
+}
+
+RecordReader::~RecordReader()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+bool RecordReader::open(const string &file)
+{
+    m_file = fopen(file.c_str(), "rb");
+    if (!m_file)
+        return false;
+
+    struct stat st;
+    if (fstat(fileno(m_file), &st) < 0)
+    {
+        fclose(m_file);
+        m_file = NULL;
+        return false;
+    }
+    m_size = (uint64_t)st.st_size;
+
+    char magic[sizeof(RECORD_MAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) ||
+        memcmp(magic, RECORD_MAGIC, sizeof(magic)))
+    {
+        fclose(m_file);
+        m_file = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+bool RecordReader::readVarint(uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int c = fgetc(m_file);
+        if (c == EOF)
+            return false;
+
+        value |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+bool RecordReader::readString(string &value)
+{
+    uint64_t size;
+    if (!readVarint(size))
+        return false;
+
+    /* A corrupt length must not allocate more than what is left in the log */
+    long pos = ftell(m_file);
+    if (pos < 0 || size > m_size - (uint64_t)pos)
+        return false;
+
+    value.resize(size);
+    return size == 0 || fread(&value[0], 1, size, m_file) == size;
+}
+
+bool RecordReader::next(RecordEntry &entry)
+{
+    while (true)
+    {
+        int type = fgetc(m_file);
+        if (type == EOF)
+            return false;
+
+        uint64_t delta, id;
+        string key;
+
+        /* Anything but the end of the log between two records is corrupt */
+        m_corrupt = true;
+
+        if (type == RECORD_TABLE)
+        {
+            string table;
+            if (!readVarint(id) || !readString(table))
+                return false;
+
+            /* The tables are numbered in the order they are named */
+            if (id > m_tables.size())
+                return false;
+
+            if (id == m_tables.size())
+                m_tables.push_back(table);
+            else
+                m_tables[id] = table;
+
+            m_corrupt = false;
+            continue;
+        }
+
+        if ((type != RECORD_SET && type != RECORD_DEL) ||
+            !readVarint(delta) || !readVarint(id) || !readString(key) ||
+            id >= m_tables.size())
+            return false;
+
+        vector<FieldValueTuple> values;
+        if (type == RECORD_SET)
+        {
+            uint64_t count;
+            if (!readVarint(count))
+                return false;
+
+            for (uint64_t i = 0; i < count; i++)
+            {
+                string field, value;
+                if (!readString(field) || !readString(value))
+                    return false;
+                values.push_back(FieldValueTuple(field, value));
+            }
+        }
+
+        m_corrupt = false;
+
+        m_lastTime += delta;
+
+        entry.time = m_lastTime;
+        entry.table = m_tables[id];
+        entry.kco = KeyOpFieldsValuesTuple(key, type == RECORD_SET ? SET_COMMAND : DEL_COMMAND, values);
+        return true;
+    }
+}
+
+}
@@ -0,0 +1,123 @@
+#ifndef SWSS_RECORDER_H
+#define SWSS_RECORDER_H
+
+#include "table.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace swss {
+
+/*
+ * The record log is a binary file of the KeyOpFieldsValuesTuple produced
+ * or consumed by a daemon, with the time they were seen at. It starts
+ * with RECORD_MAGIC followed by records made of a type byte and varint
+ * encoded fields, strings being a varint length and the bytes:
+ *
+ *   RECORD_TABLE   table id, table name
+ *   RECORD_SET     time delta, table id, key, field count, fields/values
+ *   RECORD_DEL     time delta, table id, key
+ *
+ * A table is named once in the log and referred to by its id after. The
+ * first time delta is from the epoch, the others from the previous
+ * record, in microseconds.
+ */
+#define RECORD_MAGIC    "SWSSREC1"
+
+#define RECORD_TABLE    'T'
+#define RECORD_SET      'S'
+#define RECORD_DEL      'D'
+
+/*
+ * The records are buffered and written out once the buffer is full, or by
+ * the first record() or poll() call once the interval in microseconds has
+ * passed since the last write. An idle daemon must call poll() from its
+ * select timeout for the tail of the log to reach the file.
+ */
+#define RECORD_FLUSH_INTERVAL   1000000
+#define RECORD_BUFFER_SIZE      65536
+
+class Recorder
+{
+public:
+    static Recorder &getInstance();
+
+    /* Start recording into file, return false if it cannot be opened */
+    bool open(const std::string &file);
+    void close();
+
+    bool isOpen() const { return m_recording.load(std::memory_order_relaxed); }
+
+    /* Write out the buffered records if the flush interval has passed */
+    void poll();
+
+    /*
+     * Close the record log when SIGTERM or SIGINT is received, then let the
+     * signal terminate the daemon. Must be called before starting any thread.
+     */
+    void closeOnSignal();
+
+    void record(const std::string &table, const KeyOpFieldsValuesTuple &kco);
+    void record(const std::string &table, const std::string &key,
+                const std::string &op, const std::vector<FieldValueTuple> &values);
+
+private:
+    Recorder();
+    ~Recorder();
+
+    std::mutex m_mutex;
+    std::atomic<bool> m_recording;
+    FILE *m_file;
+    std::string m_buffer;
+    std::map<std::string, uint32_t> m_tableIds;
+    uint64_t m_lastTime;
+    uint64_t m_lastFlush;
+
+    uint32_t getTableId(const std::string &table);
+    void flush();
+    void flushIfDue(uint64_t now);
+};
+
+/* RecordEntry: one task read back from a record log */
+struct RecordEntry
+{
+    uint64_t                time;       // microseconds since the epoch
+    std::string             table;      // table name
+    KeyOpFieldsValuesTuple  kco;        // key, op and fields/values
+};
+
+class RecordReader
+{
+public:
+    RecordReader();
+    ~RecordReader();
+
+    /* Open a record log, return false if it cannot be opened or is not one */
+    bool open(const std::string &file);
+
+    /* Read the next task, return false at the end of the log or on a truncated or corrupt record */
+    bool next(RecordEntry &entry);
+
+    /* Tell whether next() stopped on a truncated or corrupt record */
+    bool isCorrupt() const { return m_corrupt; }
+
+private:
+    FILE *m_file;
+    uint64_t m_size;
+    bool m_corrupt;
+    std::vector<std::string> m_tables;
+    uint64_t m_lastTime;
+
+    bool readVarint(uint64_t &value);
+    bool readString(std::string &value);
+};
+
+}
+
+#endif /* SWSS_RECORDER_H */
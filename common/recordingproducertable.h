@@ -0,0 +1,43 @@
+#ifndef SWSS_RECORDINGPRODUCERTABLE_H
+#define SWSS_RECORDINGPRODUCERTABLE_H
+
+#include "producertable.h"
+#include "common/recorder.h"
+
+#include <string>
+#include <vector>
+
+namespace swss {
+
+/*
+ * RecordingProducerTable: a ProducerTable also writing the tasks it
+ * produces into the record log, when one is open.
+ */
+class RecordingProducerTable : public ProducerTable
+{
+public:
+    RecordingProducerTable(DBConnector *db, std::string tableName) :
+        ProducerTable(db, tableName),
+        m_tableName(tableName)
+    {
+    }
+
+    void set(std::string key, std::vector<FieldValueTuple> &values)
+    {
+        ProducerTable::set(key, values);
+        Recorder::getInstance().record(m_tableName, key, SET_COMMAND, values);
+    }
+
+    void del(std::string key)
+    {
+        ProducerTable::del(key);
+        Recorder::getInstance().record(m_tableName, key, DEL_COMMAND, {});
+    }
+
+private:
+    std::string m_tableName;
+};
+
+}
+
+#endif /* SWSS_RECORDINGPRODUCERTABLE_H */
@@ -1,143 +1,434 @@
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/un.h>
+#include <algorithm>
 #include <system_error>
 #include "logger.h"
-#include "netmsg.h"
-#include "netdispatcher.h"
 #include "fpmsyncd/fpmlink.h"
 
 using namespace swss;
 using namespace std;
 
-FpmLink::FpmLink(int port) :
-    m_bufSize(FPM_MAX_MSG_LEN * 2),
-    m_messageBuffer(NULL),
-    m_pos(0),
-    m_connected(false),
-    m_server_up(false)
+/* Create a non-blocking listening socket bound to addr, closed on error */
+static int listenSocket(int domain, struct sockaddr *addr, socklen_t len)
 {
-    struct sockaddr_in addr;
     int true_val = 1;
+    int sock;
 
-    m_server_socket = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (m_server_socket < 0)
+    sock = socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0)
         throw std::system_error(errno, std::system_category());
 
-    if (setsockopt(m_server_socket, SOL_SOCKET, SO_REUSEADDR, &true_val,
-                   sizeof(true_val)) < 0)
+    if (domain == AF_INET)
+    {
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &true_val,
+                       sizeof(true_val)) < 0)
+        {
+            close(sock);
+            throw std::system_error(errno, std::system_category());
+        }
+
+        if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &true_val,
+                       sizeof(true_val)) < 0)
+        {
+            close(sock);
+            throw std::system_error(errno, std::system_category());
+        }
+    }
+
+    if (bind(sock, addr, len) < 0)
     {
-        close(m_server_socket);
+        close(sock);
         throw std::system_error(errno, std::system_category());
     }
 
-    if (setsockopt(m_server_socket, SOL_SOCKET, SO_KEEPALIVE, &true_val,
-                   sizeof(true_val)) < 0)
+    if (listen(sock, FPM_LISTEN_BACKLOG) != 0)
     {
-        close(m_server_socket);
+        close(sock);
         throw std::system_error(errno, std::system_category());
     }
 
+    return sock;
+}
+
+FpmLink::FpmLink(EpollSelect *select, RouteSync *rsync, int port, const string &path) :
+    m_select(select),
+    m_routesync(rsync),
+    m_server_socket(-1),
+    m_unix_socket(-1),
+    m_unix_path(path)
+{
+    struct sockaddr_in addr;
+
     memset (&addr, 0, sizeof (addr));
     addr.sin_family = AF_INET;
     addr.sin_port = htons(port);
     addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
 
-    if (bind(m_server_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    m_server_socket = listenSocket(AF_INET, (struct sockaddr *)&addr, sizeof(addr));
+
+    if (!m_unix_path.empty())
     {
-        close(m_server_socket);
-        throw std::system_error(errno, std::system_category());
+        struct sockaddr_un un;
+
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        if (m_unix_path.size() >= sizeof(un.sun_path))
+        {
+            ::close(m_server_socket);
+            throw std::system_error(make_error_code(errc::filename_too_long), m_unix_path);
+        }
+        strcpy(un.sun_path, m_unix_path.c_str());
+
+        /* Remove the socket left by a previous instance */
+        unlink(m_unix_path.c_str());
+
+        try
+        {
+            m_unix_socket = listenSocket(AF_UNIX, (struct sockaddr *)&un, sizeof(un));
+        }
+        catch (...)
+        {
+            ::close(m_server_socket);
+            throw;
+        }
     }
+}
 
-    if (listen(m_server_socket, 2) != 0)
+FpmLink::~FpmLink()
+{
+    for (auto &c : m_connections)
+        m_select->removeSelectable(c.first);
+
+    if (m_unix_socket >= 0)
     {
-        close(m_server_socket);
-        throw std::system_error(errno, std::system_category());
+        ::close(m_unix_socket);
+        unlink(m_unix_path.c_str());
     }
+    ::close(m_server_socket);
+}
 
-    m_server_up = true;
-    m_messageBuffer = new char[m_bufSize];
+void FpmLink::addFd(fd_set *fd)
+{
+    FD_SET(m_server_socket, fd);
+    if (m_unix_socket >= 0)
+        FD_SET(m_unix_socket, fd);
 }
 
-FpmLink::~FpmLink()
+bool FpmLink::isMe(fd_set *fd)
 {
-    delete m_messageBuffer;
-    if (m_connected)
-        close(m_connection_socket);
-    if (m_server_up)
-        close(m_server_socket);
+    return FD_ISSET(m_server_socket, fd) ||
+           (m_unix_socket >= 0 && FD_ISSET(m_unix_socket, fd));
 }
 
-void FpmLink::accept()
+int FpmLink::readCache()
 {
-    struct sockaddr_in client_addr;
-    socklen_t client_len;
+    /* FPM doesn't have any caching */
+    return NODATA;
+}
 
-    m_connection_socket = ::accept(m_server_socket, (struct sockaddr *)&client_addr,
-                                   &client_len);
-    if (m_connection_socket < 0)
-        throw std::system_error(errno, std::system_category());
+void FpmLink::readMe()
+{
+    /* The listening sockets are non-blocking, take what is pending on both */
+    accept(m_server_socket);
+    if (m_unix_socket >= 0)
+        accept(m_unix_socket);
+}
 
-    SWSS_LOG_INFO("New connection accepted from: %s\n", inet_ntoa(client_addr.sin_addr));
+void FpmLink::accept(int server)
+{
+    while (true)
+    {
+        struct sockaddr_storage client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        char addr[INET_ADDRSTRLEN];
+        string peer;
+
+        int sock = ::accept4(server, (struct sockaddr *)&client_addr, &client_len,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (sock < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                SWSS_LOG_ERROR("Failed to accept FPM connection: %s\n", strerror(errno));
+            return;
+        }
+
+        /* The routes of concurrent clients would overwrite each other, see FpmLink */
+        if (!m_connections.empty())
+        {
+            SWSS_LOG_ERROR("Reject FPM connection, already serving %s\n",
+                           m_connections.begin()->first->getPeer().c_str());
+            ::close(sock);
+            continue;
+        }
+
+        /* The peer names the statistics of the connection, keep it unique */
+        if (client_addr.ss_family == AF_INET)
+        {
+            struct sockaddr_in *in = (struct sockaddr_in *)&client_addr;
+            peer = inet_ntop(AF_INET, &in->sin_addr, addr, sizeof(addr));
+            peer += ":" + to_string(ntohs(in->sin_port));
+        }
+        else
+        {
+            peer = m_unix_path + ":" + to_string(sock);
+        }
+
+        auto connection = make_shared<FpmConnection>(this, m_routesync, sock, peer);
+        m_connections[connection.get()] = connection;
+        m_select->addSelectable(connection.get());
+
+        SWSS_LOG_NOTICE("New connection accepted from: %s\n", peer.c_str());
+    }
 }
 
-void FpmLink::addFd(fd_set *fd)
+void FpmLink::close(FpmConnection *connection)
 {
-    FD_SET(m_connection_socket, fd);
+    auto it = m_connections.find(connection);
+    if (it == m_connections.end())
+        return;
+
+    SWSS_LOG_NOTICE("Connection lost from: %s\n", connection->getPeer().c_str());
+
+    m_select->removeSelectable(connection);
+    m_closed.push_back(it->second);
+    m_closedPeers.push_back(connection->getPeer());
+    m_connections.erase(it);
 }
 
-bool FpmLink::isMe(fd_set *fd)
+void FpmLink::releaseClosed()
 {
-    return FD_ISSET(m_connection_socket, fd);
+    m_closed.clear();
 }
 
-int FpmLink::readCache()
+void FpmLink::publishStats(Table &table, double interval)
+{
+    for (auto &peer : m_closedPeers)
+        table.del(peer);
+    m_closedPeers.clear();
+
+    for (auto &c : m_connections)
+        c.second->publishStats(table, interval);
+}
+
+FpmConnection::FpmConnection(FpmLink *link, RouteSync *rsync, int socket, const string &peer) :
+    m_link(link),
+    m_routesync(rsync),
+    m_socket(socket),
+    m_peer(peer),
+    m_stats(),
+    m_bufSize(FPM_MIN_BUFFER_SIZE),
+    m_messageBuffer(NULL),
+    m_start(0),
+    m_end(0),
+    m_smallReads(0)
+{
+    m_messageBuffer = new char[m_bufSize];
+}
+
+FpmConnection::~FpmConnection()
+{
+    delete[] m_messageBuffer;
+    close(m_socket);
+}
+
+void FpmConnection::addFd(fd_set *fd)
+{
+    FD_SET(m_socket, fd);
+}
+
+bool FpmConnection::isMe(fd_set *fd)
+{
+    return FD_ISSET(m_socket, fd);
+}
+
+int FpmConnection::readCache()
 {
     /* FPM doesn't have any caching */
     return NODATA;
 }
 
-void FpmLink::readMe()
+void FpmConnection::readMe()
+{
+    for (int i = 0; i < FPM_MAX_READS; i++)
+    {
+        /*
+         * Rewind for free once everything is parsed, and only move the
+         * partial message left to the front when the tail can no longer
+         * hold a whole one.
+         */
+        if (m_start == m_end)
+        {
+            m_start = m_end = 0;
+        }
+        else if (m_bufSize - m_end < FPM_MAX_MSG_LEN)
+        {
+            memmove(m_messageBuffer, m_messageBuffer + m_start, m_end - m_start);
+            m_end -= m_start;
+            m_start = 0;
+        }
+
+        size_t space = m_bufSize - m_end;
+        ssize_t read = ::read(m_socket, m_messageBuffer + m_end, space);
+        if (read < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            /* Drained, write what we have */
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                m_routesync->flush();
+                return;
+            }
+
+            SWSS_LOG_ERROR("Failed to read from %s: %s\n", m_peer.c_str(), strerror(errno));
+        }
+
+        if (read <= 0)
+        {
+            /* Zebra resends its whole table when it reconnects */
+            m_routesync->flush();
+            m_link->close(this);
+            return;
+        }
+
+        m_end += read;
+        m_stats.bytes += read;
+
+        if (!parse())
+        {
+            m_link->close(this);
+            return;
+        }
+
+        if (m_start != m_end)
+            m_stats.partial++;
+
+        /* The client is sending faster than we read, read more at once */
+        if ((size_t)read == space && space >= m_bufSize / 2)
+            grow();
+
+        /* The burst is over, give the memory back once nothing is pending */
+        if ((size_t)read < m_bufSize / 4)
+            m_smallReads++;
+        else
+            m_smallReads = 0;
+
+        if (m_smallReads >= FPM_SHRINK_READS && m_start == m_end)
+            shrink();
+    }
+}
+
+/* Handle the complete messages in the buffer, return false on a malformed one */
+bool FpmConnection::parse()
 {
     fpm_msg_hdr_t *hdr;
     size_t msg_len;
-    size_t start = 0, left;
-    ssize_t read;
+    size_t left;
 
-    read = ::read(m_connection_socket, m_messageBuffer + m_pos, m_bufSize - m_pos);
-    if (read == 0)
-        throw FpmConnectionClosedException();
-    if (read < 0)
-        throw std::system_error(errno, std::system_category());
-    m_pos+= read;
-
-    /* Check for complete messages */
     while (true)
     {
-        hdr = (fpm_msg_hdr_t *)(m_messageBuffer + start);
-        left = m_pos - start;
+        hdr = (fpm_msg_hdr_t *)(m_messageBuffer + m_start);
+        left = m_end - m_start;
         if (left < FPM_MSG_HDR_LEN)
             break;
+
+        /* The header bounds the message to FPM_MAX_MSG_LEN, which always fits in the buffer */
+        if (!fpm_msg_hdr_ok(hdr))
+        {
+            SWSS_LOG_ERROR("Malformed FPM message received from %s\n", m_peer.c_str());
+            return false;
+        }
+
         /* fpm_msg_len includes header size */
         msg_len = fpm_msg_len(hdr);
         if (left < msg_len)
             break;
 
-        if (!fpm_msg_ok(hdr, left))
-            throw std::system_error(make_error_code(errc::bad_message), "Malformed FPM message received");
-
         if (hdr->msg_type == FPM_MSG_TYPE_NETLINK)
         {
-            nl_msg *msg = nlmsg_convert((nlmsghdr *)fpm_msg_data(hdr));
-            if (msg == NULL)
-                throw std::system_error(make_error_code(errc::bad_message), "Unable to convert nlmsg");
+            nlmsghdr *nlh = (nlmsghdr *)fpm_msg_data(hdr);
+            if (fpm_msg_data_len(hdr) < NLMSG_LENGTH(sizeof(struct rtmsg)) ||
+                nlh->nlmsg_len > fpm_msg_data_len(hdr))
+            {
+                SWSS_LOG_ERROR("Malformed netlink message received from %s\n", m_peer.c_str());
+                return false;
+            }
 
-            nlmsg_set_proto(msg, NETLINK_ROUTE);
-            NetDispatcher::getInstance().onNetlinkMessage(msg);
-            nlmsg_free(msg);
+            /* Zebra only sends routes over FPM, parse them in place */
+            if (nlh->nlmsg_type == RTM_NEWROUTE || nlh->nlmsg_type == RTM_DELROUTE)
+                m_routesync->onMsgRaw(nlh);
         }
-        start += msg_len;
+
+        m_start += msg_len;
+        m_stats.messages++;
     }
 
-    memmove(m_messageBuffer, m_messageBuffer + start, m_pos - start);
-    m_pos = m_pos - start;
+    return true;
+}
+
+void FpmConnection::grow()
+{
+    if (m_bufSize >= FPM_MAX_BUFFER_SIZE)
+        return;
+
+    size_t size = min<size_t>(m_bufSize * 2, FPM_MAX_BUFFER_SIZE);
+    char *buffer = new char[size];
+
+    memcpy(buffer, m_messageBuffer + m_start, m_end - m_start);
+    delete[] m_messageBuffer;
+
+    m_messageBuffer = buffer;
+    m_bufSize = size;
+    m_end -= m_start;
+    m_start = 0;
+}
+
+/* Halve the buffer, only called while it holds no partial message */
+void FpmConnection::shrink()
+{
+    m_smallReads = 0;
+
+    if (m_bufSize <= FPM_MIN_BUFFER_SIZE)
+        return;
+
+    size_t size = max<size_t>(m_bufSize / 2, FPM_MIN_BUFFER_SIZE);
+    char *buffer = new char[size];
+
+    delete[] m_messageBuffer;
+
+    m_messageBuffer = buffer;
+    m_bufSize = size;
+    m_start = m_end = 0;
+}
+
+void FpmConnection::publishStats(Table &table, double interval)
+{
+    vector<FieldValueTuple> fvs;
+    uint64_t bytes_per_sec = 0, messages_per_sec = 0, partial_per_sec = 0;
+
+    if (interval > 0)
+    {
+        bytes_per_sec = (uint64_t)((m_stats.bytes - m_stats.published_bytes) / interval);
+        messages_per_sec = (uint64_t)((m_stats.messages - m_stats.published_messages) / interval);
+        partial_per_sec = (uint64_t)((m_stats.partial - m_stats.published_partial) / interval);
+    }
+
+    m_stats.published_bytes = m_stats.bytes;
+    m_stats.published_messages = m_stats.messages;
+    m_stats.published_partial = m_stats.partial;
+
+    fvs.push_back(FieldValueTuple("BYTES", to_string(m_stats.bytes)));
+    fvs.push_back(FieldValueTuple("MESSAGES", to_string(m_stats.messages)));
+    fvs.push_back(FieldValueTuple("PARTIAL", to_string(m_stats.partial)));
+    fvs.push_back(FieldValueTuple("BYTES_PER_SEC", to_string(bytes_per_sec)));
+    fvs.push_back(FieldValueTuple("MESSAGES_PER_SEC", to_string(messages_per_sec)));
+    fvs.push_back(FieldValueTuple("PARTIAL_PER_SEC", to_string(partial_per_sec)));
+    fvs.push_back(FieldValueTuple("BUFFER_SIZE", to_string(m_bufSize)));
+
+    table.set(m_peer, fvs);
 }
@@ -10,39 +10,135 @@
 #include <assert.h>
 #include <unistd.h>
 #include <exception>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "selectable.h"
+#include "table.h"
+#include "common/epollselect.h"
 #include "fpm/fpm.h"
+#include "fpmsyncd/routesync.h"
+
+/* Pending connections queued by the kernel on each listening socket */
+#define FPM_LISTEN_BACKLOG  16
+
+/*
+ * The read buffer of a connection starts at FPM_MIN_BUFFER_SIZE and
+ * doubles up to FPM_MAX_BUFFER_SIZE whenever a read fills most of it.
+ * It is halved back, while empty, after FPM_SHRINK_READS reads in a row
+ * used less than a quarter of it.
+ */
+#define FPM_MIN_BUFFER_SIZE (FPM_MAX_MSG_LEN * 16)
+#define FPM_MAX_BUFFER_SIZE (4 * 1024 * 1024)
+#define FPM_SHRINK_READS    64
+
+/* Reads done by one readMe() before giving the other selectables a turn */
+#define FPM_MAX_READS       64
+
+/* COUNTERS_DB table holding the statistics of every FPM connection */
+#define COUNTERS_FPM_STATS_TABLE    "FPM_STATS"
 
 namespace swss {
 
+class FpmLink;
+
+struct FpmStats
+{
+    uint64_t bytes;                 // bytes read from the client
+    uint64_t messages;              // FPM messages parsed
+    uint64_t partial;               // reads leaving a partial message in the buffer
+    uint64_t published_bytes;       // bytes value last published
+    uint64_t published_messages;    // messages value last published
+    uint64_t published_partial;     // partial value last published
+};
+
+/* FpmConnection: one FPM client, with its own framing buffer */
+class FpmConnection : public Selectable {
+public:
+    FpmConnection(FpmLink *link, RouteSync *rsync, int socket, const std::string &peer);
+    virtual ~FpmConnection();
+
+    virtual void addFd(fd_set *fd);
+    virtual bool isMe(fd_set *fd);
+    virtual int readCache();
+    virtual void readMe();
+
+    const std::string &getPeer() const { return m_peer; }
+
+    /* Write the statistics of the connection into table, interval is in seconds */
+    void publishStats(Table &table, double interval);
+
+private:
+    FpmLink *m_link;
+    RouteSync *m_routesync;
+    int m_socket;
+    std::string m_peer;
+    FpmStats m_stats;
+
+    /* The messages not parsed yet are between m_start and m_end */
+    size_t m_bufSize;
+    char *m_messageBuffer;
+    size_t m_start;
+    size_t m_end;
+    /* Consecutive reads using less than a quarter of the buffer */
+    unsigned int m_smallReads;
+
+    bool parse();
+    void grow();
+    void shrink();
+};
+
+/*
+ * FpmLink listens for FPM clients on the loopback TCP port and, when a
+ * path is given, on an AF_UNIX stream socket. The accepted client gets an
+ * FpmConnection added to the select, with its own framing buffer.
+ *
+ * Only one client is served at a time. RouteSync keys the routes by
+ * prefix only, not by VRF or client, so a second zebra would overwrite
+ * the routes of the first. A client connecting while another one is
+ * served is rejected, and zebra connects again once the link is free.
+ */
 class FpmLink : public Selectable {
 public:
-    FpmLink(int port = FPM_DEFAULT_PORT);
+    FpmLink(EpollSelect *select, RouteSync *rsync, int port = FPM_DEFAULT_PORT,
+            const std::string &path = "");
     virtual ~FpmLink();
 
-    /* Wait for connection (blocking) */
-    void accept();
-
     virtual void addFd(fd_set *fd);
     virtual bool isMe(fd_set *fd);
     virtual int readCache();
+    /* Accept the pending connections */
     virtual void readMe();
 
-    /* readMe throws FpmConnectionClosedException when connection is lost */
-    class FpmConnectionClosedException : public std::exception
-    {
-    };
+    /*
+     * Stop serving a connection whose client is gone. It is called from
+     * the connection's readMe(), so the connection is only deleted by
+     * releaseClosed().
+     */
+    void close(FpmConnection *connection);
+
+    /* Delete the closed connections, call it once select() has returned */
+    void releaseClosed();
+
+    /* Write the statistics of every connection into table, interval is in seconds */
+    void publishStats(Table &table, double interval);
 
 private:
-    unsigned int m_bufSize;
-    char *m_messageBuffer;
-    unsigned int m_pos;
+    EpollSelect *m_select;
+    RouteSync *m_routesync;
 
-    bool m_connected;
-    bool m_server_up;
     int m_server_socket;
-    int m_connection_socket;
+    int m_unix_socket;
+    std::string m_unix_path;
+
+    std::map<FpmConnection *, std::shared_ptr<FpmConnection> > m_connections;
+    std::vector<std::shared_ptr<FpmConnection> > m_closed;
+    /* Statistics keys of the connections closed since the last publish */
+    std::vector<std::string> m_closedPeers;
+
+    void accept(int server);
 };
 
 }
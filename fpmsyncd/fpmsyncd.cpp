@@ -1,50 +1,122 @@
 #include <iostream>
+#include <chrono>
 #include "logger.h"
-#include "select.h"
+#include "common/epollselect.h"
+#include "common/recorder.h"
 #include "netdispatcher.h"
+#include "netlink.h"
 #include "fpmsyncd/fpmlink.h"
 #include "fpmsyncd/routesync.h"
 
+#include <getopt.h>
+
 using namespace std;
 using namespace swss;
 
+/* Interval in seconds between two updates of the FPM statistics */
+#define STATS_INTERVAL 10
+
+void usage()
+{
+    cout << "Usage: fpmsyncd [-u unix_socket] [-c interval] [-d half_life] [-r record_file]" << endl;
+    cout << "       -u unix_socket: also listen for the FPM client on this AF_UNIX socket path" << endl;
+    cout << "       -c interval: only publish the last update of a prefix within interval" << endl;
+    cout << "                    milliseconds (default 0, disabled)" << endl;
+    cout << "       -d half_life: dampen flapping prefixes, with a penalty half-life" << endl;
+    cout << "                     in seconds (default 0, disabled)" << endl;
+    cout << "       -r record_file: record the produced tasks into a record log" << endl;
+}
+
 int main(int argc, char **argv)
 {
+    unsigned int coalesceInterval = 0;
+    unsigned int halfLife = 0;
+    string unixPath;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "u:c:d:r:h")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'u':
+            unixPath.assign(optarg);
+            break;
+        case 'c':
+            coalesceInterval = (unsigned int)atoi(optarg);
+            break;
+        case 'd':
+            halfLife = (unsigned int)atoi(optarg);
+            break;
+        case 'r':
+            if (!Recorder::getInstance().open(optarg))
+            {
+                cerr << "Failed to open record file " << optarg << endl;
+                return EXIT_FAILURE;
+            }
+            Recorder::getInstance().closeOnSignal();
+            break;
+        case 'h':
+            usage();
+            return 1;
+        default: /* '?' */
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
     DBConnector db(APPL_DB, "localhost", 6379, 0);
     RouteSync sync(&db);
 
-    NetDispatcher::getInstance().registerMessageHandler(RTM_NEWROUTE, &sync);
-    NetDispatcher::getInstance().registerMessageHandler(RTM_DELROUTE, &sync);
+    sync.setCoalesceInterval(coalesceInterval);
+    sync.setDampening(halfLife);
 
-    while (1)
+    /* The interface names of the next hops are learnt from the link messages */
+    NetDispatcher::getInstance().registerMessageHandler(RTM_NEWLINK, &sync);
+    NetDispatcher::getInstance().registerMessageHandler(RTM_DELLINK, &sync);
+
+    NetLink netlink;
+    netlink.registerGroup(RTNLGRP_LINK);
+    netlink.dumpRequest(RTM_GETLINK);
+
+    try
     {
-        try
+        DBConnector counterDb(COUNTERS_DB, "localhost", 6379, 0);
+        Table statsTable(&counterDb, COUNTERS_FPM_STATS_TABLE);
+        auto last_stats = chrono::steady_clock::now();
+
+        EpollSelect s;
+        FpmLink fpm(&s, &sync, FPM_DEFAULT_PORT, unixPath);
+
+        s.addSelectable(&fpm);
+        s.addSelectable(&netlink);
+
+        cout << "Waiting for connections..." << endl;
+        while (true)
         {
-            FpmLink fpm;
-            Select s;
+            Selectable *temps;
+            int tempfd;
+            /* Reading FPM messages forever (and calling "readMe" to read them) */
+            if (s.select(&temps, &tempfd, ROUTESYNC_FLUSH_INTERVAL) == EpollSelect::TIMEOUT)
+            {
+                sync.flush();
+                Recorder::getInstance().poll();
+            }
 
-            cout << "Waiting for connection..." << endl;
-            fpm.accept();
-            cout << "Connected!" << endl;
+            /* The connection closed by the last readMe() is no longer referenced */
+            fpm.releaseClosed();
 
-            s.addSelectable(&fpm);
-            while (true)
+            auto now = chrono::steady_clock::now();
+            if (now - last_stats >= chrono::seconds(STATS_INTERVAL))
             {
-                Selectable *temps;
-                int tempfd;
-                /* Reading FPM messages forever (and calling "readMe" to read them) */
-                s.select(&temps, &tempfd);
+                fpm.publishStats(statsTable, chrono::duration<double>(now - last_stats).count());
+                last_stats = now;
             }
         }
-        catch (FpmLink::FpmConnectionClosedException &e)
-        {
-            cout << "Connection lost, reconnecting..." << endl;
-        }
-        catch (const std::exception& e)
-        {
-            cout << "Exception \"" << e.what() << "\" had been thrown in deamon" << endl;
-            return 0;
-        }
+    }
+    catch (const std::exception& e)
+    {
+        cout << "Exception \"" << e.what() << "\" had been thrown in deamon" << endl;
+        return 0;
     }
 
     return 1;
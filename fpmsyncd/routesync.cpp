@@ -1,10 +1,10 @@
+#include <string.h>
+#include <math.h>
+#include <arpa/inet.h>
+#include <net/if.h>
 #include <netlink/route/link.h>
-#include <netlink/route/route.h>
-#include <netlink/route/nexthop.h>
 #include "logger.h"
 #include "select.h"
-#include "netmsg.h"
-#include "ipprefix.h"
 #include "dbconnector.h"
 #include "producertable.h"
 #include "fpmsyncd/fpmlink.h"
@@ -14,67 +14,456 @@ using namespace std;
 using namespace swss;
 
 RouteSync::RouteSync(DBConnector *db) :
-    m_routeTable(db, APP_ROUTE_TABLE_NAME)
+    m_routeTable(db, APP_ROUTE_TABLE_NAME),
+    m_fvVector({ FieldValueTuple("nexthop", ""), FieldValueTuple("ifname", "") }),
+    m_blackhole({ FieldValueTuple("blackhole", "true") }),
+    m_coalesceInterval(0),
+    m_halfLife(0),
+    m_writing(0),
+    m_stop(false)
 {
-    m_nl_sock = nl_socket_alloc();
-    nl_connect(m_nl_sock, NETLINK_ROUTE);
-    rtnl_link_alloc_cache(m_nl_sock, AF_UNSPEC, &m_link_cache);
+    m_writer = thread(&RouteSync::writerLoop, this);
+}
+
+RouteSync::~RouteSync()
+{
+    /* Publish the updates still held back */
+    release(Time::max());
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_queue.insert(m_queue.end(), m_pending.begin(), m_pending.end());
+        m_stop = true;
+    }
+
+    m_cond.notify_one();
+    m_writer.join();
+}
+
+void RouteSync::setCoalesceInterval(unsigned int interval)
+{
+    m_coalesceInterval = chrono::milliseconds(interval);
+}
+
+void RouteSync::setDampening(unsigned int halfLife)
+{
+    m_halfLife = chrono::seconds(halfLife);
+}
+
+static size_t hashValues(const vector<FieldValueTuple> &values)
+{
+    hash<string> hasher;
+    size_t h = 0;
+
+    for (auto &fv : values)
+    {
+        h ^= hasher(fvField(fv)) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= hasher(fvValue(fv)) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    }
+
+    return h;
+}
+
+void RouteSync::publish(Time now, const string &key, const string &op,
+                        const vector<FieldValueTuple> &values)
+{
+    if (m_halfLife.count())
+    {
+        if (op == DEL_COMMAND)
+            m_published.erase(key);
+        else
+            m_published[key] = hashValues(values);
+    }
+
+    if (m_pending.empty())
+        m_pendingSince = now;
+
+    m_pending.emplace_back(key, op, values);
+}
+
+void RouteSync::decay(DampState &state, Time now)
+{
+    if (now <= state.updated)
+        return;
+
+    state.penalty *= exp2(-chrono::duration<double>(now - state.updated).count() / m_halfLife.count());
+    state.updated = now;
+}
+
+/*
+ * Account for the update of m_key against the published state of the
+ * prefix. Return true if the update is handled here: the announcements of
+ * a suppressed prefix are held until reuse, its withdrawals published.
+ */
+bool RouteSync::dampen(Time now, const string &op, const vector<FieldValueTuple> &values)
+{
+    auto it_published = m_published.find(m_key);
+    size_t hash = 0;
+    bool flap;
+
+    if (op == DEL_COMMAND)
+        flap = it_published != m_published.end();
+    else
+    {
+        hash = hashValues(values);
+        flap = it_published != m_published.end() && it_published->second != hash;
+    }
+
+    auto it = m_damp.find(m_key);
+    if (it == m_damp.end())
+    {
+        if (!flap)
+            return false;
+
+        DampState state;
+        state.penalty = 0;
+        state.updated = now;
+        state.suppressed = false;
+        it = m_damp.emplace(m_key, state).first;
+    }
+
+    DampState &state = it->second;
+
+    if (flap)
+    {
+        double ceiling = ROUTESYNC_REUSE_LIMIT * exp2(ROUTESYNC_MAX_SUPPRESS);
+
+        decay(state, now);
+        state.penalty += op == DEL_COMMAND ? ROUTESYNC_WITHDRAW_PENALTY : ROUTESYNC_CHANGE_PENALTY;
+        if (state.penalty > ceiling)
+            state.penalty = ceiling;
+    }
+
+    if (state.suppressed)
+    {
+        m_reuse.erase(make_pair(state.reuse, m_key));
+    }
+    else
+    {
+        if (state.penalty < ROUTESYNC_SUPPRESS_LIMIT)
+            return false;
+
+        SWSS_LOG_NOTICE("Suppress flapping route %s\n", m_key.c_str());
+        state.suppressed = true;
+    }
+
+    /* The update supersedes the one waiting in the window */
+    m_window.erase(m_key);
+
+    state.held.values.clear();
+    if (op == DEL_COMMAND)
+    {
+        state.held.op.clear();
+        publish(now, m_key, op, values);
+    }
+    else if (it_published != m_published.end() && it_published->second == hash)
+    {
+        /* Back to the published state, nothing to publish on reuse */
+        state.held.op.clear();
+    }
+    else
+    {
+        state.held.op = op;
+        state.held.values = values;
+    }
+
+    state.reuse = state.updated + chrono::duration_cast<Time::duration>(
+            m_halfLife * log2(state.penalty / ROUTESYNC_REUSE_LIMIT));
+    m_reuse.insert(make_pair(state.reuse, m_key));
+    return true;
+}
+
+/* Publish the prefixes whose coalescing interval or suppression is over at now */
+void RouteSync::release(Time now)
+{
+    while (!m_windowOrder.empty() && m_windowOrder.front().first <= now)
+    {
+        /* Skip the entries of updates erased from the window since */
+        auto it = m_window.find(m_windowOrder.front().second);
+        if (it != m_window.end() && it->second.release == m_windowOrder.front().first)
+        {
+            publish(now, it->first, it->second.op, it->second.values);
+            m_window.erase(it);
+        }
+        m_windowOrder.pop_front();
+    }
+
+    while (!m_reuse.empty() && m_reuse.begin()->first <= now)
+    {
+        DampState &state = m_damp[m_reuse.begin()->second];
+
+        SWSS_LOG_NOTICE("Reuse dampened route %s\n", m_reuse.begin()->second.c_str());
+        if (!state.held.op.empty())
+            publish(now, m_reuse.begin()->second, state.held.op, state.held.values);
+        state.suppressed = false;
+        state.held.op.clear();
+        state.held.values.clear();
+        m_reuse.erase(m_reuse.begin());
+    }
+
+    /* Forget the prefixes which stopped flapping once per half-life */
+    if (m_halfLife.count() && now != Time::max() && now - m_lastSweep >= m_halfLife)
+    {
+        for (auto it = m_damp.begin(); it != m_damp.end();)
+        {
+            decay(it->second, now);
+            if (!it->second.suppressed && it->second.penalty < ROUTESYNC_REUSE_LIMIT / 2)
+                it = m_damp.erase(it);
+            else
+                it++;
+        }
+        m_lastSweep = now;
+    }
+}
+
+void RouteSync::enqueue(const string &op, const vector<FieldValueTuple> &values)
+{
+    auto now = chrono::steady_clock::now();
+
+    if (m_halfLife.count() && dampen(now, op, values))
+    {
+        /* Held until the prefix is reused, or already published */
+    }
+    else if (m_coalesceInterval.count())
+    {
+        auto it = m_window.find(m_key);
+        if (it == m_window.end())
+        {
+            it = m_window.emplace(m_key, RouteUpdate()).first;
+            it->second.release = now + m_coalesceInterval;
+            m_windowOrder.emplace_back(it->second.release, m_key);
+        }
+
+        it->second.op = op;
+        it->second.values = values;
+    }
+    else
+    {
+        publish(now, m_key, op, values);
+    }
+
+    if (m_pending.size() >= ROUTESYNC_BATCH_SIZE ||
+        (!m_pending.empty() && now - m_pendingSince >= chrono::milliseconds(ROUTESYNC_FLUSH_INTERVAL)) ||
+        (!m_windowOrder.empty() && m_windowOrder.front().first <= now) ||
+        (!m_reuse.empty() && m_reuse.begin()->first <= now))
+        flush();
+}
+
+void RouteSync::flush()
+{
+    release(chrono::steady_clock::now());
+
+    unique_lock<mutex> lock(m_mutex);
+
+    if (m_error)
+        rethrow_exception(m_error);
+
+    if (m_pending.empty())
+        return;
+
+    if (m_queue.empty())
+    {
+        m_queue.swap(m_pending);
+    }
+    else
+    {
+        m_queue.insert(m_queue.end(), make_move_iterator(m_pending.begin()),
+                       make_move_iterator(m_pending.end()));
+        m_pending.clear();
+    }
+
+    m_cond.notify_one();
+
+    if (m_queue.size() + m_writing < ROUTESYNC_QUEUE_HIGH)
+        return;
+
+    SWSS_LOG_INFO("Wait for %zu route operations to be written\n", m_queue.size() + m_writing);
+    m_drained.wait(lock, [this]() {
+        return m_error || m_queue.size() + m_writing < ROUTESYNC_QUEUE_LOW;
+    });
+
+    if (m_error)
+        rethrow_exception(m_error);
+}
+
+void RouteSync::writerLoop()
+{
+    vector<KeyOpFieldsValuesTuple> batch;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+            if (m_queue.empty())
+                return;
+
+            /* Give back the drained vector so both keep their capacity */
+            batch.swap(m_queue);
+            m_writing = batch.size();
+        }
+
+        try
+        {
+            size_t written = 0;
+            for (auto &kco : batch)
+            {
+                if (kfvOp(kco) == DEL_COMMAND)
+                    m_routeTable.del(kfvKey(kco));
+                else
+                    m_routeTable.set(kfvKey(kco), kfvFieldsValues(kco));
+
+                /* Report the progress to a flush() waiting for the queue to drain */
+                if (++written % ROUTESYNC_BATCH_SIZE == 0 || written == batch.size())
+                {
+                    lock_guard<mutex> lock(m_mutex);
+                    m_writing = batch.size() - written;
+                    m_drained.notify_one();
+                }
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_error = current_exception();
+            m_drained.notify_one();
+            return;
+        }
+
+        batch.clear();
+    }
 }
 
 void RouteSync::onMsg(int nlmsg_type, struct nl_object *obj)
 {
-    struct rtnl_route *route_obj = (struct rtnl_route *)obj;
-    struct nl_addr *dip;
-    char ifname[MAX_ADDR_SIZE + 1] = {0};
-    uint32_t ipv4;
-    int prefix;
+    struct rtnl_link *link = (struct rtnl_link *)obj;
+    int ifindex = rtnl_link_get_ifindex(link);
+    const char *name = rtnl_link_get_name(link);
+
+    if (nlmsg_type == RTM_DELLINK)
+        m_ifNames.erase(ifindex);
+    else if (nlmsg_type == RTM_NEWLINK && name)
+        m_ifNames[ifindex] = name;
+}
+
+const string &RouteSync::getIfName(int ifindex)
+{
+    static const string unknown("unknown");
+    char name[IF_NAMESIZE];
+
+    /* A gateway only next hop has no interface */
+    if (ifindex == 0)
+        return unknown;
+
+    auto it = m_ifNames.find(ifindex);
+    if (it != m_ifNames.end())
+        return it->second;
+
+    /*
+     * Not learnt from netlink yet, only ask the kernel about this one. An
+     * index the kernel doesn't know stays unknown until RTM_NEWLINK names
+     * it, so a burst of routes through it costs a single lookup.
+     */
+    if (!if_indextoname(ifindex, name))
+        return m_ifNames[ifindex] = unknown;
+
+    return m_ifNames[ifindex] = name;
+}
+
+void RouteSync::appendNextHop(int family, struct rtattr *gateway, int ifindex)
+{
+    string &nexthops = fvValue(m_fvVector[0]);
+    string &ifnames = fvValue(m_fvVector[1]);
+    char buf[MAX_ADDR_SIZE + 1] = {0};
 
-    dip = rtnl_route_get_dst(route_obj);
-    /* Supports IPv4 address only for now */
-    if (rtnl_route_get_family(route_obj)  != AF_INET)
+    if (!nexthops.empty() || !ifnames.empty())
     {
-        nl_addr2str(dip, ifname, MAX_ADDR_SIZE);
-        SWSS_LOG_INFO("%s: Unknown route family support: %s (object: %s)\n",
-                      __FUNCTION__, ifname, nl_object_get_type(obj));
+        nexthops += ',';
+        ifnames += ',';
+    }
+
+    if (gateway && RTA_PAYLOAD(gateway) >= (family == AF_INET ? 4 : 16))
+    {
+        inet_ntop(family, RTA_DATA(gateway), buf, sizeof(buf));
+        nexthops += buf;
+    }
+
+    ifnames += getIfName(ifindex);
+}
+
+void RouteSync::onMsgRaw(struct nlmsghdr *h)
+{
+    struct rtmsg *rtm = (struct rtmsg *)NLMSG_DATA(h);
+    struct rtattr *tb[RTA_MAX + 1];
+    int len = (int)h->nlmsg_len - NLMSG_LENGTH(sizeof(*rtm));
+    char dst[MAX_ADDR_SIZE + 1] = {0};
+    unsigned char zero[16] = {0};
+
+    if (len < 0)
+    {
+        SWSS_LOG_ERROR("%s: Truncated route message of length %u\n",
+                       __FUNCTION__, h->nlmsg_len);
         return;
     }
 
-    prefix = nl_addr_get_prefixlen(dip);
-    ipv4 = *(uint32_t*)nl_addr_get_binary_addr(dip);
-    IpPrefix destip(ipv4, prefix);
+    if (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6)
+    {
+        SWSS_LOG_INFO("%s: Unknown route family support: %d\n",
+                      __FUNCTION__, rtm->rtm_family);
+        return;
+    }
+
+    memset(tb, 0, sizeof(tb));
+    for (struct rtattr *rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+    {
+        if (rta->rta_type <= RTA_MAX)
+            tb[rta->rta_type] = rta;
+    }
+
+    /* No destination attribute is the default route */
+    const void *addr = zero;
+    if (tb[RTA_DST])
+    {
+        if (RTA_PAYLOAD(tb[RTA_DST]) < (rtm->rtm_family == AF_INET ? 4 : 16))
+        {
+            SWSS_LOG_ERROR("%s: Truncated route destination\n", __FUNCTION__);
+            return;
+        }
+        addr = RTA_DATA(tb[RTA_DST]);
+    }
+
+    inet_ntop(rtm->rtm_family, addr, dst, sizeof(dst));
+    m_key.assign(dst);
+    m_key += '/';
+    m_key += to_string(rtm->rtm_dst_len);
 
-    if (nlmsg_type == RTM_DELROUTE)
+    if (h->nlmsg_type == RTM_DELROUTE)
     {
-        m_routeTable.del(destip.to_string());
+        enqueue(DEL_COMMAND, {});
         return;
     }
-    else if (nlmsg_type != RTM_NEWROUTE)
+    else if (h->nlmsg_type != RTM_NEWROUTE)
     {
-        nl_addr2str(dip, ifname, MAX_ADDR_SIZE);
         SWSS_LOG_INFO("%s: Unknown message-type: %d for %s\n",
-                      __FUNCTION__, nlmsg_type, ifname);
+                      __FUNCTION__, h->nlmsg_type, m_key.c_str());
         return;
     }
 
-    switch (rtnl_route_get_type(route_obj))
+    switch (rtm->rtm_type)
     {
         case RTN_BLACKHOLE:
-            {
-                std::vector<FieldValueTuple> fvVector;
-                FieldValueTuple fv("blackhole", "true");
-                fvVector.push_back(fv);
-                m_routeTable.set(destip.to_string(), fvVector);
-                return;
-            }
+            enqueue(SET_COMMAND, m_blackhole);
+            return;
+
         case RTN_UNICAST:
             break;
 
         case RTN_MULTICAST:
         case RTN_BROADCAST:
         case RTN_LOCAL:
-            nl_addr2str(dip, ifname, MAX_ADDR_SIZE);
             SWSS_LOG_INFO("%s: BUM routes aren't supported yet (%s)\n",
-                          __FUNCTION__, ifname);
+                          __FUNCTION__, m_key.c_str());
             return;
 
         default:
@@ -82,52 +471,42 @@ void RouteSync::onMsg(int nlmsg_type, struct nl_object *obj)
     }
 
     /* Geting nexthop lists */
-    string nexthops;
-    string ifnames;
-
-    struct nl_list_head *nhs = rtnl_route_get_nexthops(route_obj);
-    if (!nhs)
-    {
-        nl_addr2str(dip, ifname, MAX_ADDR_SIZE);
-        SWSS_LOG_INFO("%s: Nexthop list is empty for %s\n",
-                      __FUNCTION__, ifname);
-        return;
-    }
+    fvValue(m_fvVector[0]).clear();
+    fvValue(m_fvVector[1]).clear();
 
-    for (int i = 0; i < rtnl_route_get_nnexthops(route_obj); i++)
+    if (tb[RTA_MULTIPATH])
     {
-        struct rtnl_nexthop *nexthop = rtnl_route_nexthop_n(route_obj, i);
-        struct nl_addr *addr = rtnl_route_nh_get_gateway(nexthop);
-        unsigned int ifindex = rtnl_route_nh_get_ifindex(nexthop);
+        struct rtnexthop *rtnh = (struct rtnexthop *)RTA_DATA(tb[RTA_MULTIPATH]);
+        int nhlen = (int)RTA_PAYLOAD(tb[RTA_MULTIPATH]);
 
-        if (addr != NULL)
+        for (; RTNH_OK(rtnh, nhlen); nhlen -= RTNH_ALIGN(rtnh->rtnh_len), rtnh = RTNH_NEXT(rtnh))
         {
-            IpAddress nh(*(uint32_t*)nl_addr_get_binary_addr(addr));
-            nexthops += nh.to_string();
-        }
+            struct rtattr *gateway = NULL;
+            int attrlen = rtnh->rtnh_len - sizeof(*rtnh);
 
-        rtnl_link_i2name(m_link_cache, ifindex, ifname, MAX_ADDR_SIZE);
-        /* Cannot get ifname. Possibly interfaces get re-created. */
-        if (!strlen(ifname))
-        {
-            rtnl_link_alloc_cache(m_nl_sock, AF_UNSPEC, &m_link_cache);
-            rtnl_link_i2name(m_link_cache, ifindex, ifname, MAX_ADDR_SIZE);
-            if (!strlen(ifname))
-                strcpy(ifname, "unknown");
-        }
-        ifnames += ifname;
+            for (struct rtattr *rta = RTNH_DATA(rtnh); RTA_OK(rta, attrlen); rta = RTA_NEXT(rta, attrlen))
+            {
+                if (rta->rta_type == RTA_GATEWAY)
+                    gateway = rta;
+            }
 
-        if (i + 1 < rtnl_route_get_nnexthops(route_obj))
-        {
-            nexthops += string(",");
-            ifnames += string(",");
+            appendNextHop(rtm->rtm_family, gateway, rtnh->rtnh_ifindex);
         }
     }
+    else if (tb[RTA_GATEWAY] || tb[RTA_OIF])
+    {
+        int ifindex = 0;
+        if (tb[RTA_OIF] && RTA_PAYLOAD(tb[RTA_OIF]) >= sizeof(int))
+            ifindex = *(int *)RTA_DATA(tb[RTA_OIF]);
+        appendNextHop(rtm->rtm_family, tb[RTA_GATEWAY], ifindex);
+    }
+
+    if (fvValue(m_fvVector[1]).empty())
+    {
+        SWSS_LOG_INFO("%s: Nexthop list is empty for %s\n",
+                      __FUNCTION__, m_key.c_str());
+        return;
+    }
 
-    std::vector<FieldValueTuple> fvVector;
-    FieldValueTuple nh("nexthop", nexthops);
-    FieldValueTuple idx("ifname", ifnames);
-    fvVector.push_back(nh);
-    fvVector.push_back(idx);
-    m_routeTable.set(destip.to_string(), fvVector);
+    enqueue(SET_COMMAND, m_fvVector);
 }
@@ -1,25 +1,154 @@
 #ifndef __ROUTESYNC__
 #define __ROUTESYNC__
 
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
 #include "dbconnector.h"
-#include "producertable.h"
+#include "common/recordingproducertable.h"
 #include "netmsg.h"
 
 namespace swss {
 
+/*
+ * Route operations are handed to the writer thread in batches, when the
+ * FPM socket is drained, at ROUTESYNC_BATCH_SIZE operations, or when the
+ * oldest pending one is ROUTESYNC_FLUSH_INTERVAL milliseconds old.
+ */
+#define ROUTESYNC_BATCH_SIZE        1024
+#define ROUTESYNC_FLUSH_INTERVAL    10
+
+/*
+ * Once ROUTESYNC_QUEUE_HIGH operations are queued or being written, flush()
+ * blocks until the writer thread is down to ROUTESYNC_QUEUE_LOW. The FPM
+ * sockets are not read meanwhile, so that TCP flow control slows zebra
+ * down instead of the queue growing without bound.
+ */
+#define ROUTESYNC_QUEUE_HIGH        65536
+#define ROUTESYNC_QUEUE_LOW         16384
+
+/*
+ * Flap dampening after RFC 2439: a withdrawal of a published prefix, or
+ * an announcement differing from its published state, adds a penalty
+ * which halves every half-life. Once the penalty reaches the suppress
+ * limit, the withdrawals of the prefix are still published at once but
+ * its announcements are held until the penalty decays to the reuse limit,
+ * when the last one is published. The penalty is capped so that a prefix
+ * is not suppressed for more than ROUTESYNC_MAX_SUPPRESS half-lives.
+ */
+#define ROUTESYNC_WITHDRAW_PENALTY  1000
+#define ROUTESYNC_CHANGE_PENALTY    500
+#define ROUTESYNC_SUPPRESS_LIMIT    2000
+#define ROUTESYNC_REUSE_LIMIT       750
+#define ROUTESYNC_MAX_SUPPRESS      4
+
 class RouteSync : public NetMsg
 {
 public:
     enum { MAX_ADDR_SIZE = 64 };
 
+    /* db is only used by the writer thread */
     RouteSync(DBConnector *db);
+    ~RouteSync();
 
+    /* Only publish the last update of a prefix within interval milliseconds, 0 to disable */
+    void setCoalesceInterval(unsigned int interval);
+    /* Dampen flapping prefixes with a penalty half-life in seconds, 0 to disable */
+    void setDampening(unsigned int halfLife);
+
+    /*
+     * Handle a RTM_NEWROUTE/RTM_DELROUTE message in place, parsing its
+     * attributes straight from the FPM buffer instead of converting it
+     * into a libnl route object.
+     */
+    void onMsgRaw(struct nlmsghdr *h);
+
+    /* Track the interface names from the RTM_NEWLINK/RTM_DELLINK messages */
     virtual void onMsg(int nlmsg_type, struct nl_object *obj);
 
+    /*
+     * Publish the coalesced and dampened updates which are due and hand
+     * the pending operations to the writer thread, waiting for it if it
+     * is too far behind. Rethrows the exception that stopped the writer
+     * thread if any.
+     */
+    void flush();
+
 private:
-    ProducerTable m_routeTable;
-    struct nl_cache *m_link_cache;
-    struct nl_sock *m_nl_sock;
+    typedef std::chrono::steady_clock::time_point Time;
+
+    /* RouteUpdate: last operation received for a prefix */
+    struct RouteUpdate
+    {
+        std::string op;
+        std::vector<FieldValueTuple> values;
+        Time release;               // end of its coalescing interval
+    };
+
+    /* DampState: flap history of a prefix */
+    struct DampState
+    {
+        double      penalty;        // penalty at updated
+        Time        updated;        // time the penalty was last decayed
+        bool        suppressed;     // updates are held until reuse
+        Time        reuse;          // time the prefix can be reused
+        RouteUpdate held;           // announcement to publish on reuse, empty op if none
+    };
+
+    RecordingProducerTable m_routeTable;
+    /* Interface names by ifindex, "unknown" for an index the kernel didn't know */
+    std::unordered_map<int, std::string> m_ifNames;
+
+    /* Reused between messages so that steady state parsing doesn't allocate */
+    std::string m_key;
+    std::vector<FieldValueTuple> m_fvVector;
+    std::vector<FieldValueTuple> m_blackhole;
+
+    /* Prefixes updated within the coalescing interval, by release time */
+    std::chrono::milliseconds m_coalesceInterval;
+    std::unordered_map<std::string, RouteUpdate> m_window;
+    std::deque<std::pair<Time, std::string> > m_windowOrder;
+
+    /* Prefixes with a penalty, suppressed ones by reuse time */
+    std::chrono::duration<double> m_halfLife;
+    std::unordered_map<std::string, DampState> m_damp;
+    /* Hash of the values last published for each announced prefix, when dampening */
+    std::unordered_map<std::string, size_t> m_published;
+    std::set<std::pair<Time, std::string> > m_reuse;
+    Time m_lastSweep;
+
+    /* Operations published since the last flush and the time of the first one */
+    std::vector<KeyOpFieldsValuesTuple> m_pending;
+    std::chrono::steady_clock::time_point m_pendingSince;
+
+    /* Operations handed to the writer thread, protected by m_mutex */
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::condition_variable m_drained;
+    std::vector<KeyOpFieldsValuesTuple> m_queue;
+    size_t m_writing;               // operations taken but not written yet
+    std::exception_ptr m_error;
+    bool m_stop;
+    std::thread m_writer;
+
+    void enqueue(const std::string &op, const std::vector<FieldValueTuple> &values);
+    void publish(Time now, const std::string &key, const std::string &op,
+                 const std::vector<FieldValueTuple> &values);
+    bool dampen(Time now, const std::string &op, const std::vector<FieldValueTuple> &values);
+    void decay(DampState &state, Time now);
+    void release(Time now);
+    void writerLoop();
+    void appendNextHop(int family, struct rtattr *gateway, int ifindex);
+    const std::string &getIfName(int ifindex);
 };
 
 }
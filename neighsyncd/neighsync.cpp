@@ -34,8 +34,11 @@ void NeighSync::onMsg(int nlmsg_type, struct nl_object *obj)
     else if (rtnl_neigh_get_family(neigh) == AF_INET6)
     {
         family = IPV6_NAME;
-        /* Currently IPv6 is not supported */
-        return;
+
+        /* Link-local neighbors are never next hops of the routes */
+        const uint8_t *addr = (const uint8_t *)nl_addr_get_binary_addr(rtnl_neigh_get_dst(neigh));
+        if (addr[0] == 0xfe && (addr[1] & 0xc0) == 0x80)
+            return;
     }
     else
         return;
@@ -1,15 +1,47 @@
 #include <iostream>
 #include "logger.h"
-#include "select.h"
+#include "common/epollselect.h"
+#include "common/recorder.h"
 #include "netdispatcher.h"
 #include "netlink.h"
 #include "neighsyncd/neighsync.h"
 
+#include <getopt.h>
+
 using namespace std;
 using namespace swss;
 
+void usage()
+{
+    cout << "Usage: neighsyncd [-r record_file]" << endl;
+    cout << "       -r record_file: record the produced tasks into a record log" << endl;
+}
+
 int main(int argc, char **argv)
 {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:h")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'r':
+            if (!Recorder::getInstance().open(optarg))
+            {
+                cerr << "Failed to open record file " << optarg << endl;
+                return EXIT_FAILURE;
+            }
+            Recorder::getInstance().closeOnSignal();
+            break;
+        case 'h':
+            usage();
+            return 1;
+        default: /* '?' */
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
     DBConnector db(APPL_DB, "localhost", 6379, 0);
     NeighSync sync(&db);
 
@@ -21,7 +53,7 @@ int main(int argc, char **argv)
         try
         {
             NetLink netlink;
-            Select s;
+            EpollSelect s;
 
             netlink.registerGroup(RTNLGRP_NEIGH);
             cout << "Listens to neigh messages..." << endl;
@@ -32,7 +64,8 @@ int main(int argc, char **argv)
             {
                 Selectable *temps;
                 int tempfd;
-                s.select(&temps, &tempfd);
+                if (s.select(&temps, &tempfd, RECORD_FLUSH_INTERVAL / 1000) == EpollSelect::TIMEOUT)
+                    Recorder::getInstance().poll();
             }
         }
         catch (const std::exception& e)
@@ -0,0 +1,85 @@
+#ifndef SWSS_BULKER_H
+#define SWSS_BULKER_H
+
+extern "C" {
+#include "sai.h"
+#include "saistatus.h"
+}
+
+#include <vector>
+
+using namespace std;
+
+extern sai_route_api_t*             sai_route_api;
+
+/*
+ * RouteBulker collects the route create/set/remove operations of one
+ * doTask pass and submits them together in flush(). Each operation
+ * reports its own status through the pointer given when it is queued.
+ *
+ * The SAI version in use has no bulk route API, so flush() still issues
+ * one call per entry. It is the single place to switch over to the bulk
+ * create/set/remove calls once the SAI library provides them.
+ */
+class RouteBulker
+{
+public:
+    void create_entry(sai_status_t *status, const sai_unicast_route_entry_t *entry,
+                      uint32_t attr_count, const sai_attribute_t *attr_list)
+    {
+        m_creating.push_back({ *entry, vector<sai_attribute_t>(attr_list, attr_list + attr_count), status });
+    }
+
+    void set_entry_attribute(sai_status_t *status, const sai_unicast_route_entry_t *entry,
+                             const sai_attribute_t *attr)
+    {
+        m_setting.push_back({ *entry, vector<sai_attribute_t>(1, *attr), status });
+    }
+
+    void remove_entry(sai_status_t *status, const sai_unicast_route_entry_t *entry)
+    {
+        m_removing.push_back({ *entry, vector<sai_attribute_t>(), status });
+    }
+
+    size_t size() const
+    {
+        return m_creating.size() + m_setting.size() + m_removing.size();
+    }
+
+    /* Remove first to free hardware resources, then create, then set */
+    void flush()
+    {
+        for (auto &it : m_removing)
+            *it.status = sai_route_api->remove_route(&it.entry);
+
+        for (auto &it : m_creating)
+            *it.status = sai_route_api->create_route(&it.entry,
+                    (uint32_t)it.attrs.size(), it.attrs.data());
+
+        for (auto &it : m_setting)
+            *it.status = sai_route_api->set_route_attribute(&it.entry, it.attrs.data());
+
+        clear();
+    }
+
+    void clear()
+    {
+        m_creating.clear();
+        m_setting.clear();
+        m_removing.clear();
+    }
+
+private:
+    struct RouteBulkEntry
+    {
+        sai_unicast_route_entry_t   entry;
+        vector<sai_attribute_t>     attrs;
+        sai_status_t               *status;
+    };
+
+    vector<RouteBulkEntry> m_creating;
+    vector<RouteBulkEntry> m_setting;
+    vector<RouteBulkEntry> m_removing;
+};
+
+#endif /* SWSS_BULKER_H */
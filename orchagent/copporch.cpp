@@ -254,14 +254,12 @@ bool CoppOrch::createPolicer(string trap_group_name, vector<sai_attribute_t> &po
     return true;
 }
 
-task_process_status CoppOrch::processCoppRule(Consumer& consumer)
+task_process_status CoppOrch::processCoppRule(KeyOpFieldsValuesTuple &tuple)
 {
     SWSS_LOG_ENTER();
     sai_status_t sai_status;
     vector<string> trap_id_list;
     string queue_ind;
-    auto it = consumer.m_toSync.begin();
-    KeyOpFieldsValuesTuple tuple = it->second;
     string trap_group_name = kfvKey(tuple);
     string op = kfvOp(tuple);
 
@@ -505,7 +503,7 @@ void CoppOrch::doTask(Consumer &consumer)
         task_process_status task_status;
         try
         {
-            task_status = processCoppRule(consumer);
+            task_status = processCoppRule(tuple);
         }
         catch(const out_of_range e)
         {
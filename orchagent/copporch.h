@@ -25,7 +25,7 @@ public:
     CoppOrch(DBConnector *db, string tableName);
 protected:
     virtual void doTask(Consumer& consumer);
-    task_process_status processCoppRule(Consumer& consumer);
+    task_process_status processCoppRule(KeyOpFieldsValuesTuple &tuple);
     bool isValidList(vector<string> &trap_id_list, vector<string> &all_items) const;
     void getTrapIdList(vector<string> &trap_id_name_list, vector<sai_hostif_trap_id_t> &trap_id_list) const;
     bool applyTrapIds(sai_object_id_t trap_group, vector<string> &trap_id_name_list, vector<sai_attribute_t> &trap_id_attribs);
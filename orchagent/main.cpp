@@ -1,4 +1,6 @@
 #include "orchdaemon.h"
+#include "saitracer.h"
+#include "common/recorder.h"
 
 #include "logger.h"
 
@@ -39,6 +41,14 @@ sai_object_id_t gVirtualRouterId;
 sai_object_id_t underlayIfId;
 MacAddress gMacAddress;
 
+/* Maximum number of tasks popped from a consumer table per select wakeup */
+int gBatchSize = DEFAULT_BATCH_SIZE;
+
+/* Time every SAI call and publish the statistics to COUNTERS_DB */
+bool gSaiTrace = false;
+/* Run the independent orchs on their own thread */
+bool gThreaded = false;
+
 const char *test_profile_get_value (
     _In_ sai_switch_profile_id_t profile_id,
     _In_ const char *variable)
@@ -103,6 +113,9 @@ void initSaiApi()
     sai_log_set(SAI_API_LAG,                    SAI_LOG_NOTICE);
     sai_log_set(SAI_API_POLICER,                SAI_LOG_NOTICE);
     sai_log_set(SAI_API_TUNNEL,                 SAI_LOG_NOTICE);
+
+    if (gSaiTrace)
+        installSaiTracer();
 }
 
 int main(int argc, char **argv)
@@ -114,13 +127,35 @@ int main(int argc, char **argv)
     int opt;
     sai_status_t status;
 
-    while ((opt = getopt(argc, argv, "m:h")) != -1)
+    while ((opt = getopt(argc, argv, "b:m:r:tTh")) != -1)
     {
         switch (opt)
         {
+        case 'b':
+            gBatchSize = atoi(optarg);
+            if (gBatchSize <= 0)
+            {
+                SWSS_LOG_ERROR("Invalid batch size %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'm':
             gMacAddress = MacAddress(optarg);
             break;
+        case 'r':
+            if (!Recorder::getInstance().open(optarg))
+            {
+                SWSS_LOG_ERROR("Failed to open record file %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            Recorder::getInstance().closeOnSignal();
+            break;
+        case 't':
+            gSaiTrace = true;
+            break;
+        case 'T':
+            gThreaded = true;
+            break;
         case 'h':
             exit(EXIT_SUCCESS);
         default: /* '?' */
@@ -194,7 +229,7 @@ int main(int argc, char **argv)
 
     SWSS_LOG_NOTICE("Created underlay router interface ID %llx\n", underlayIfId);
 
-    OrchDaemon *orchDaemon = new OrchDaemon();
+    OrchDaemon *orchDaemon = new OrchDaemon(gThreaded);
     if (!orchDaemon->init())
     {
         SWSS_LOG_ERROR("Failed to initialize orchstration daemon\n");
@@ -0,0 +1,1067 @@
+#include "mocksai.h"
+
+#include "logger.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/* Large enough for every sai_api_t of the SAI version in use */
+#define MOCK_SAI_API_MAX        64
+
+#define MOCK_SAI_DEFAULT_VLAN_ID    1
+
+enum mock_object_type_t
+{
+    MOCK_OBJECT_PORT = 1,
+    MOCK_OBJECT_VIRTUAL_ROUTER,
+    MOCK_OBJECT_ROUTER_INTERFACE,
+    MOCK_OBJECT_NEXT_HOP,
+    MOCK_OBJECT_NEXT_HOP_GROUP,
+    MOCK_OBJECT_VLAN_MEMBER,
+    MOCK_OBJECT_HOST_INTERFACE,
+    MOCK_OBJECT_TRAP_GROUP,
+    MOCK_OBJECT_LAG,
+    MOCK_OBJECT_LAG_MEMBER,
+    MOCK_OBJECT_POLICER,
+    MOCK_OBJECT_TUNNEL,
+    MOCK_OBJECT_TUNNEL_TERM_TABLE_ENTRY,
+};
+
+struct MockSaiApiConfig
+{
+    atomic<uint32_t> latency_us;        // busy wait of every call
+    atomic<uint32_t> failure_ppm;       // failed calls per million
+    atomic<int32_t> failure_status;     // status of the failed calls
+    atomic<uint64_t> calls;             // calls made
+    atomic<uint64_t> failures;          // failures injected
+};
+
+/* Attributes are copied shallowly, only scalar values can be read back */
+typedef map<sai_attr_id_t, sai_attribute_value_t> MockAttributes;
+
+/* MockAddress: address family, address and mask with the unused bytes zeroed */
+struct MockAddress
+{
+    uint64_t            id;                 // virtual router or router interface
+    int32_t             family;
+    uint32_t            reserved;           // always 0, no padding to hash
+    uint8_t             addr[16];
+    uint8_t             mask[16];
+
+    bool operator==(const MockAddress &o) const
+    {
+        return id == o.id && family == o.family &&
+               !memcmp(addr, o.addr, sizeof(addr)) && !memcmp(mask, o.mask, sizeof(mask));
+    }
+};
+
+struct MockAddressHash
+{
+    size_t operator()(const MockAddress &key) const
+    {
+        /* FNV-1a over the whole key */
+        const uint8_t *p = (const uint8_t *)&key;
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < sizeof(key); i++)
+            h = (h ^ p[i]) * 0x100000001b3ULL;
+        return (size_t)h;
+    }
+};
+
+struct MockObject
+{
+    mock_object_type_t          type;
+    MockAttributes              attrs;
+    set<sai_object_id_t>        members;    // next hop group members
+    uint32_t                    ref_count;  // routes, groups and next hops using the object
+    MockAddress                 neighbor;   // neighbor of a next hop, id 0 if none
+};
+
+struct MockNeighbor
+{
+    MockAttributes              attrs;
+    uint32_t                    ref_count;  // next hops using the neighbor
+};
+
+static MockSaiApiConfig g_apiConfig[MOCK_SAI_API_MAX];
+
+static uint32_t g_portCount = MOCK_SAI_DEFAULT_PORT_COUNT;
+static uint32_t g_maxEcmpGroups = MOCK_SAI_DEFAULT_ECMP_GROUPS;
+
+/* The switch state, every access is under g_mutex */
+static mutex g_mutex;
+static uint64_t g_nextObjectIndex = 0;
+static unordered_map<sai_object_id_t, MockObject> g_objects;
+static unordered_map<MockAddress, MockAttributes, MockAddressHash> g_routes;
+static unordered_map<MockAddress, MockNeighbor, MockAddressHash> g_neighbors;
+static map<sai_vlan_id_t, bool> g_vlans;
+static map<int, MockAttributes> g_traps;
+static vector<sai_object_id_t> g_ports;
+static sai_object_id_t g_cpuPort;
+static sai_object_id_t g_defaultVirtualRouter;
+static sai_object_id_t g_defaultTrapGroup;
+static sai_mac_t g_srcMac = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+static uint32_t g_nextHopGroupCount = 0;
+
+/* Apply the latency and decide whether the call fails, before taking g_mutex */
+static sai_status_t enterCall(sai_api_t api)
+{
+    MockSaiApiConfig &config = g_apiConfig[api];
+
+    config.calls.fetch_add(1, memory_order_relaxed);
+
+    uint32_t latency = config.latency_us.load(memory_order_relaxed);
+    if (latency)
+    {
+        auto until = chrono::steady_clock::now() + chrono::microseconds(latency);
+        while (chrono::steady_clock::now() < until)
+            ;
+    }
+
+    uint32_t ppm = config.failure_ppm.load(memory_order_relaxed);
+    if (ppm)
+    {
+        static thread_local minstd_rand rng(1);
+        if (rng() % 1000000 < ppm)
+        {
+            config.failures.fetch_add(1, memory_order_relaxed);
+            return config.failure_status.load(memory_order_relaxed);
+        }
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+static MockAddress getMockAddress(uint64_t id, const sai_ip_address_t &ip)
+{
+    MockAddress key;
+    memset(&key, 0, sizeof(key));
+
+    key.id = id;
+    key.family = ip.addr_family;
+    if (ip.addr_family == SAI_IP_ADDR_FAMILY_IPV4)
+        memcpy(key.addr, &ip.addr.ip4, sizeof(ip.addr.ip4));
+    else
+        memcpy(key.addr, ip.addr.ip6, sizeof(ip.addr.ip6));
+
+    return key;
+}
+
+static MockAddress getMockAddress(const sai_unicast_route_entry_t &entry)
+{
+    MockAddress key;
+    memset(&key, 0, sizeof(key));
+
+    key.id = entry.vr_id;
+    key.family = entry.destination.addr_family;
+    if (entry.destination.addr_family == SAI_IP_ADDR_FAMILY_IPV4)
+    {
+        memcpy(key.addr, &entry.destination.addr.ip4, sizeof(entry.destination.addr.ip4));
+        memcpy(key.mask, &entry.destination.mask.ip4, sizeof(entry.destination.mask.ip4));
+    }
+    else
+    {
+        memcpy(key.addr, entry.destination.addr.ip6, sizeof(entry.destination.addr.ip6));
+        memcpy(key.mask, entry.destination.mask.ip6, sizeof(entry.destination.mask.ip6));
+    }
+
+    return key;
+}
+
+static void setAttributes(MockAttributes &attrs, uint32_t attr_count, const sai_attribute_t *attr_list)
+{
+    for (uint32_t i = 0; i < attr_count; i++)
+        attrs[attr_list[i].id] = attr_list[i].value;
+}
+
+static sai_status_t getAttributes(const MockAttributes &attrs, uint32_t attr_count, sai_attribute_t *attr_list)
+{
+    for (uint32_t i = 0; i < attr_count; i++)
+    {
+        auto it = attrs.find(attr_list[i].id);
+        if (it == attrs.end())
+            return SAI_STATUS_NOT_SUPPORTED;
+        attr_list[i].value = it->second;
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t copyObjectList(sai_object_list_t &dst, const vector<sai_object_id_t> &src)
+{
+    if (dst.count < src.size())
+    {
+        dst.count = (uint32_t)src.size();
+        return SAI_STATUS_BUFFER_OVERFLOW;
+    }
+
+    dst.count = (uint32_t)src.size();
+    copy(src.begin(), src.end(), dst.list);
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_object_id_t createObject(mock_object_type_t type)
+{
+    sai_object_id_t id = ((sai_object_id_t)type << 48) | ++g_nextObjectIndex;
+    g_objects[id].type = type;
+    return id;
+}
+
+static MockObject *findObject(sai_object_id_t id, mock_object_type_t type)
+{
+    auto it = g_objects.find(id);
+    if (it == g_objects.end() || it->second.type != type)
+        return nullptr;
+    return &it->second;
+}
+
+/* Objects referenced by others cannot be removed, as on a real switch */
+static void addReference(sai_object_id_t id)
+{
+    auto it = g_objects.find(id);
+    if (it != g_objects.end())
+        it->second.ref_count++;
+}
+
+static void removeReference(sai_object_id_t id)
+{
+    auto it = g_objects.find(id);
+    if (it != g_objects.end() && it->second.ref_count > 0)
+        it->second.ref_count--;
+}
+
+/* Generic object operations, specialized on the API and object type */
+
+template <sai_api_t Api, mock_object_type_t Type>
+static sai_status_t mock_create(sai_object_id_t *id, uint32_t attr_count, const sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(Api);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    *id = createObject(Type);
+    setAttributes(g_objects[*id].attrs, attr_count, attr_list);
+    return SAI_STATUS_SUCCESS;
+}
+
+template <sai_api_t Api, mock_object_type_t Type>
+static sai_status_t mock_remove(sai_object_id_t id)
+{
+    sai_status_t status = enterCall(Api);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockObject *object = findObject(id, Type);
+    if (object == nullptr)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    if (object->ref_count > 0)
+        return SAI_STATUS_OBJECT_IN_USE;
+
+    g_objects.erase(id);
+    return SAI_STATUS_SUCCESS;
+}
+
+template <sai_api_t Api, mock_object_type_t Type>
+static sai_status_t mock_set(sai_object_id_t id, const sai_attribute_t *attr)
+{
+    sai_status_t status = enterCall(Api);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockObject *object = findObject(id, Type);
+    if (object == nullptr)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    setAttributes(object->attrs, 1, attr);
+    return SAI_STATUS_SUCCESS;
+}
+
+template <sai_api_t Api, mock_object_type_t Type>
+static sai_status_t mock_get(sai_object_id_t id, uint32_t attr_count, sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(Api);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockObject *object = findObject(id, Type);
+    if (object == nullptr)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    return getAttributes(object->attrs, attr_count, attr_list);
+}
+
+/* Switch */
+
+static void createSwitch()
+{
+    g_objects.clear();
+    g_routes.clear();
+    g_neighbors.clear();
+    g_vlans.clear();
+    g_traps.clear();
+    g_ports.clear();
+    g_nextHopGroupCount = 0;
+
+    g_cpuPort = createObject(MOCK_OBJECT_PORT);
+    g_defaultVirtualRouter = createObject(MOCK_OBJECT_VIRTUAL_ROUTER);
+    g_defaultTrapGroup = createObject(MOCK_OBJECT_TRAP_GROUP);
+
+    /* Every port is a member of the default VLAN */
+    g_vlans[MOCK_SAI_DEFAULT_VLAN_ID] = true;
+    for (uint32_t i = 0; i < g_portCount; i++)
+    {
+        sai_object_id_t port_id = createObject(MOCK_OBJECT_PORT);
+        g_ports.push_back(port_id);
+
+        sai_object_id_t member_id = createObject(MOCK_OBJECT_VLAN_MEMBER);
+        g_objects[member_id].attrs[SAI_VLAN_MEMBER_ATTR_VLAN_ID].u16 = MOCK_SAI_DEFAULT_VLAN_ID;
+        g_objects[member_id].attrs[SAI_VLAN_MEMBER_ATTR_PORT_ID].oid = port_id;
+    }
+}
+
+static sai_status_t mock_initialize_switch(sai_switch_profile_id_t profile_id,
+        char *switch_hardware_id, char *firmware_path_name,
+        sai_switch_notification_t *switch_notifications)
+{
+    sai_status_t status = enterCall(SAI_API_SWITCH);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    createSwitch();
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_set_switch_attribute(const sai_attribute_t *attr)
+{
+    sai_status_t status = enterCall(SAI_API_SWITCH);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    if (attr->id == SAI_SWITCH_ATTR_SRC_MAC_ADDRESS)
+        memcpy(g_srcMac, attr->value.mac, sizeof(sai_mac_t));
+
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_get_switch_attribute(uint32_t attr_count, sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(SAI_API_SWITCH);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    for (uint32_t i = 0; i < attr_count; i++)
+    {
+        sai_attribute_value_t &value = attr_list[i].value;
+
+        switch (attr_list[i].id)
+        {
+            case SAI_SWITCH_ATTR_PORT_NUMBER:
+                value.u32 = (uint32_t)g_ports.size();
+                break;
+            case SAI_SWITCH_ATTR_PORT_LIST:
+                status = copyObjectList(value.objlist, g_ports);
+                if (status != SAI_STATUS_SUCCESS)
+                    return status;
+                break;
+            case SAI_SWITCH_ATTR_CPU_PORT:
+                value.oid = g_cpuPort;
+                break;
+            case SAI_SWITCH_ATTR_DEFAULT_VIRTUAL_ROUTER_ID:
+                value.oid = g_defaultVirtualRouter;
+                break;
+            case SAI_SWITCH_ATTR_DEFAULT_TRAP_GROUP:
+                value.oid = g_defaultTrapGroup;
+                break;
+            case SAI_SWITCH_ATTR_SRC_MAC_ADDRESS:
+                memcpy(value.mac, g_srcMac, sizeof(sai_mac_t));
+                break;
+            case SAI_SWITCH_ATTR_NUMBER_OF_ECMP_GROUPS:
+                value.s32 = (int32_t)g_maxEcmpGroups;
+                break;
+            case SAI_SWITCH_ATTR_ECMP_MEMBERS:
+                value.u32 = MOCK_SAI_DEFAULT_ECMP_MEMBERS;
+                break;
+            default:
+                return SAI_STATUS_NOT_SUPPORTED;
+        }
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+/* Port */
+
+static sai_status_t mock_get_port_attribute(sai_object_id_t port_id, uint32_t attr_count, sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(SAI_API_PORT);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockObject *port = findObject(port_id, MOCK_OBJECT_PORT);
+    if (port == nullptr)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    for (uint32_t i = 0; i < attr_count; i++)
+    {
+        if (attr_list[i].id != SAI_PORT_ATTR_HW_LANE_LIST)
+        {
+            status = getAttributes(port->attrs, 1, &attr_list[i]);
+            if (status != SAI_STATUS_SUCCESS)
+                return status;
+            continue;
+        }
+
+        /* Port n has the lanes 4n+1 to 4n+4, the CPU port none */
+        sai_u32_list_t &lanes = attr_list[i].value.u32list;
+        auto it = find(g_ports.begin(), g_ports.end(), port_id);
+        uint32_t count = it == g_ports.end() ? 0 : MOCK_SAI_LANES_PER_PORT;
+        if (lanes.count < count)
+        {
+            lanes.count = count;
+            return SAI_STATUS_BUFFER_OVERFLOW;
+        }
+
+        lanes.count = count;
+        for (uint32_t j = 0; j < count; j++)
+            lanes.list[j] = (uint32_t)(it - g_ports.begin()) * MOCK_SAI_LANES_PER_PORT + j + 1;
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+/* VLAN */
+
+static sai_status_t mock_create_vlan(sai_vlan_id_t vlan_id)
+{
+    sai_status_t status = enterCall(SAI_API_VLAN);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    if (g_vlans.find(vlan_id) != g_vlans.end())
+        return SAI_STATUS_ITEM_ALREADY_EXISTS;
+
+    g_vlans[vlan_id] = true;
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_remove_vlan(sai_vlan_id_t vlan_id)
+{
+    sai_status_t status = enterCall(SAI_API_VLAN);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    if (g_vlans.erase(vlan_id) == 0)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_get_vlan_attribute(sai_vlan_id_t vlan_id, uint32_t attr_count, sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(SAI_API_VLAN);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    if (g_vlans.find(vlan_id) == g_vlans.end())
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    for (uint32_t i = 0; i < attr_count; i++)
+    {
+        if (attr_list[i].id != SAI_VLAN_ATTR_MEMBER_LIST)
+            return SAI_STATUS_NOT_SUPPORTED;
+
+        vector<sai_object_id_t> members;
+        for (auto &it : g_objects)
+        {
+            if (it.second.type == MOCK_OBJECT_VLAN_MEMBER &&
+                it.second.attrs[SAI_VLAN_MEMBER_ATTR_VLAN_ID].u16 == vlan_id)
+                members.push_back(it.first);
+        }
+
+        status = copyObjectList(attr_list[i].value.objlist, members);
+        if (status != SAI_STATUS_SUCCESS)
+            return status;
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+/* Host interface */
+
+static sai_status_t mock_set_trap_attribute(sai_hostif_trap_id_t trap_id, const sai_attribute_t *attr)
+{
+    sai_status_t status = enterCall(SAI_API_HOST_INTERFACE);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    setAttributes(g_traps[trap_id], 1, attr);
+    return SAI_STATUS_SUCCESS;
+}
+
+/* Neighbor */
+
+static sai_status_t mock_create_neighbor_entry(const sai_neighbor_entry_t *neighbor_entry,
+        uint32_t attr_count, const sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(SAI_API_NEIGHBOR);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    if (findObject(neighbor_entry->rif_id, MOCK_OBJECT_ROUTER_INTERFACE) == nullptr)
+        return SAI_STATUS_INVALID_PARAMETER;
+
+    MockAddress key = getMockAddress(neighbor_entry->rif_id, neighbor_entry->ip_address);
+    if (g_neighbors.find(key) != g_neighbors.end())
+        return SAI_STATUS_ITEM_ALREADY_EXISTS;
+
+    setAttributes(g_neighbors[key].attrs, attr_count, attr_list);
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_remove_neighbor_entry(const sai_neighbor_entry_t *neighbor_entry)
+{
+    sai_status_t status = enterCall(SAI_API_NEIGHBOR);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    auto it = g_neighbors.find(getMockAddress(neighbor_entry->rif_id, neighbor_entry->ip_address));
+    if (it == g_neighbors.end())
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    if (it->second.ref_count > 0)
+        return SAI_STATUS_OBJECT_IN_USE;
+
+    g_neighbors.erase(it);
+    return SAI_STATUS_SUCCESS;
+}
+
+/* Next hop */
+
+static sai_status_t mock_create_next_hop(sai_object_id_t *next_hop_id,
+        uint32_t attr_count, const sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(SAI_API_NEXT_HOP);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    *next_hop_id = createObject(MOCK_OBJECT_NEXT_HOP);
+    MockObject &next_hop = g_objects[*next_hop_id];
+    setAttributes(next_hop.attrs, attr_count, attr_list);
+
+    /* An IP next hop references the neighbor it resolves to, if any */
+    auto it_ip = next_hop.attrs.find(SAI_NEXT_HOP_ATTR_IP);
+    auto it_rif = next_hop.attrs.find(SAI_NEXT_HOP_ATTR_ROUTER_INTERFACE_ID);
+    if (it_ip != next_hop.attrs.end() && it_rif != next_hop.attrs.end())
+    {
+        MockAddress key = getMockAddress(it_rif->second.oid, it_ip->second.ipaddr);
+        auto it = g_neighbors.find(key);
+        if (it != g_neighbors.end())
+        {
+            it->second.ref_count++;
+            next_hop.neighbor = key;
+        }
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_remove_next_hop(sai_object_id_t next_hop_id)
+{
+    sai_status_t status = enterCall(SAI_API_NEXT_HOP);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockObject *next_hop = findObject(next_hop_id, MOCK_OBJECT_NEXT_HOP);
+    if (next_hop == nullptr)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    if (next_hop->ref_count > 0)
+        return SAI_STATUS_OBJECT_IN_USE;
+
+    if (next_hop->neighbor.id)
+    {
+        auto it = g_neighbors.find(next_hop->neighbor);
+        if (it != g_neighbors.end())
+            it->second.ref_count--;
+    }
+
+    g_objects.erase(next_hop_id);
+    return SAI_STATUS_SUCCESS;
+}
+
+/* Next hop group */
+
+static sai_status_t mock_create_next_hop_group(sai_object_id_t *next_hop_group_id,
+        uint32_t attr_count, const sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(SAI_API_NEXT_HOP_GROUP);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    if (g_nextHopGroupCount >= g_maxEcmpGroups)
+        return SAI_STATUS_INSUFFICIENT_RESOURCES;
+
+    set<sai_object_id_t> members;
+    for (uint32_t i = 0; i < attr_count; i++)
+    {
+        if (attr_list[i].id != SAI_NEXT_HOP_GROUP_ATTR_NEXT_HOP_LIST)
+            continue;
+
+        const sai_object_list_t &list = attr_list[i].value.objlist;
+        for (uint32_t j = 0; j < list.count; j++)
+        {
+            if (findObject(list.list[j], MOCK_OBJECT_NEXT_HOP) == nullptr)
+                return SAI_STATUS_INVALID_PARAMETER;
+            members.insert(list.list[j]);
+        }
+    }
+
+    if (members.size() > MOCK_SAI_DEFAULT_ECMP_MEMBERS)
+        return SAI_STATUS_INSUFFICIENT_RESOURCES;
+
+    *next_hop_group_id = createObject(MOCK_OBJECT_NEXT_HOP_GROUP);
+    g_objects[*next_hop_group_id].members = members;
+    for (auto member : members)
+        addReference(member);
+    g_nextHopGroupCount++;
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_remove_next_hop_group(sai_object_id_t next_hop_group_id)
+{
+    sai_status_t status = enterCall(SAI_API_NEXT_HOP_GROUP);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockObject *group = findObject(next_hop_group_id, MOCK_OBJECT_NEXT_HOP_GROUP);
+    if (group == nullptr)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    if (group->ref_count > 0)
+        return SAI_STATUS_OBJECT_IN_USE;
+
+    for (auto member : group->members)
+        removeReference(member);
+
+    g_objects.erase(next_hop_group_id);
+    g_nextHopGroupCount--;
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_add_next_hop_to_group(sai_object_id_t next_hop_group_id,
+        uint32_t next_hop_count, const sai_object_id_t *nexthops)
+{
+    sai_status_t status = enterCall(SAI_API_NEXT_HOP_GROUP);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockObject *group = findObject(next_hop_group_id, MOCK_OBJECT_NEXT_HOP_GROUP);
+    if (group == nullptr)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    for (uint32_t i = 0; i < next_hop_count; i++)
+    {
+        if (findObject(nexthops[i], MOCK_OBJECT_NEXT_HOP) == nullptr)
+            return SAI_STATUS_INVALID_PARAMETER;
+    }
+
+    if (group->members.size() + next_hop_count > MOCK_SAI_DEFAULT_ECMP_MEMBERS)
+        return SAI_STATUS_INSUFFICIENT_RESOURCES;
+
+    for (uint32_t i = 0; i < next_hop_count; i++)
+    {
+        if (group->members.insert(nexthops[i]).second)
+            addReference(nexthops[i]);
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_remove_next_hop_from_group(sai_object_id_t next_hop_group_id,
+        uint32_t next_hop_count, const sai_object_id_t *nexthops)
+{
+    sai_status_t status = enterCall(SAI_API_NEXT_HOP_GROUP);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockObject *group = findObject(next_hop_group_id, MOCK_OBJECT_NEXT_HOP_GROUP);
+    if (group == nullptr)
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    for (uint32_t i = 0; i < next_hop_count; i++)
+    {
+        if (group->members.erase(nexthops[i]))
+            removeReference(nexthops[i]);
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+/* Route */
+
+static bool isRouteNextHop(sai_object_id_t id)
+{
+    auto it = g_objects.find(id);
+    if (it == g_objects.end())
+        return false;
+
+    switch (it->second.type)
+    {
+        case MOCK_OBJECT_PORT:
+        case MOCK_OBJECT_ROUTER_INTERFACE:
+        case MOCK_OBJECT_NEXT_HOP:
+        case MOCK_OBJECT_NEXT_HOP_GROUP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static sai_status_t mock_create_route(const sai_unicast_route_entry_t *unicast_route_entry,
+        uint32_t attr_count, const sai_attribute_t *attr_list)
+{
+    sai_status_t status = enterCall(SAI_API_ROUTE);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    MockAddress key = getMockAddress(*unicast_route_entry);
+    if (g_routes.find(key) != g_routes.end())
+        return SAI_STATUS_ITEM_ALREADY_EXISTS;
+
+    for (uint32_t i = 0; i < attr_count; i++)
+    {
+        if (attr_list[i].id == SAI_ROUTE_ATTR_NEXT_HOP_ID && !isRouteNextHop(attr_list[i].value.oid))
+            return SAI_STATUS_INVALID_PARAMETER;
+    }
+
+    setAttributes(g_routes[key], attr_count, attr_list);
+
+    auto it = g_routes[key].find(SAI_ROUTE_ATTR_NEXT_HOP_ID);
+    if (it != g_routes[key].end())
+        addReference(it->second.oid);
+
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_remove_route(const sai_unicast_route_entry_t *unicast_route_entry)
+{
+    sai_status_t status = enterCall(SAI_API_ROUTE);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    auto it = g_routes.find(getMockAddress(*unicast_route_entry));
+    if (it == g_routes.end())
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    auto it_next_hop = it->second.find(SAI_ROUTE_ATTR_NEXT_HOP_ID);
+    if (it_next_hop != it->second.end())
+        removeReference(it_next_hop->second.oid);
+
+    g_routes.erase(it);
+    return SAI_STATUS_SUCCESS;
+}
+
+static sai_status_t mock_set_route_attribute(const sai_unicast_route_entry_t *unicast_route_entry,
+        const sai_attribute_t *attr)
+{
+    sai_status_t status = enterCall(SAI_API_ROUTE);
+    if (status != SAI_STATUS_SUCCESS)
+        return status;
+
+    lock_guard<mutex> lock(g_mutex);
+
+    auto it = g_routes.find(getMockAddress(*unicast_route_entry));
+    if (it == g_routes.end())
+        return SAI_STATUS_ITEM_NOT_FOUND;
+
+    if (attr->id == SAI_ROUTE_ATTR_NEXT_HOP_ID)
+    {
+        if (!isRouteNextHop(attr->value.oid))
+            return SAI_STATUS_INVALID_PARAMETER;
+
+        auto it_next_hop = it->second.find(SAI_ROUTE_ATTR_NEXT_HOP_ID);
+        if (it_next_hop != it->second.end())
+            removeReference(it_next_hop->second.oid);
+        addReference(attr->value.oid);
+    }
+
+    setAttributes(it->second, 1, attr);
+    return SAI_STATUS_SUCCESS;
+}
+
+/* The API tables, filled in by sai_api_initialize() */
+static sai_switch_api_t             mock_switch_api;
+static sai_virtual_router_api_t     mock_virtual_router_api;
+static sai_port_api_t               mock_port_api;
+static sai_vlan_api_t               mock_vlan_api;
+static sai_router_interface_api_t   mock_router_intfs_api;
+static sai_hostif_api_t             mock_hostif_api;
+static sai_neighbor_api_t           mock_neighbor_api;
+static sai_next_hop_api_t           mock_next_hop_api;
+static sai_next_hop_group_api_t     mock_next_hop_group_api;
+static sai_route_api_t              mock_route_api;
+static sai_lag_api_t                mock_lag_api;
+static sai_policer_api_t            mock_policer_api;
+static sai_tunnel_api_t             mock_tunnel_api;
+
+static void initApiTables()
+{
+    memset(&mock_switch_api, 0, sizeof(mock_switch_api));
+    mock_switch_api.initialize_switch = mock_initialize_switch;
+    mock_switch_api.set_switch_attribute = mock_set_switch_attribute;
+    mock_switch_api.get_switch_attribute = mock_get_switch_attribute;
+
+    memset(&mock_virtual_router_api, 0, sizeof(mock_virtual_router_api));
+    mock_virtual_router_api.create_virtual_router = mock_create<SAI_API_VIRTUAL_ROUTER, MOCK_OBJECT_VIRTUAL_ROUTER>;
+    mock_virtual_router_api.remove_virtual_router = mock_remove<SAI_API_VIRTUAL_ROUTER, MOCK_OBJECT_VIRTUAL_ROUTER>;
+    mock_virtual_router_api.set_virtual_router_attribute = mock_set<SAI_API_VIRTUAL_ROUTER, MOCK_OBJECT_VIRTUAL_ROUTER>;
+    mock_virtual_router_api.get_virtual_router_attribute = mock_get<SAI_API_VIRTUAL_ROUTER, MOCK_OBJECT_VIRTUAL_ROUTER>;
+
+    memset(&mock_port_api, 0, sizeof(mock_port_api));
+    mock_port_api.set_port_attribute = mock_set<SAI_API_PORT, MOCK_OBJECT_PORT>;
+    mock_port_api.get_port_attribute = mock_get_port_attribute;
+
+    memset(&mock_vlan_api, 0, sizeof(mock_vlan_api));
+    mock_vlan_api.create_vlan = mock_create_vlan;
+    mock_vlan_api.remove_vlan = mock_remove_vlan;
+    mock_vlan_api.get_vlan_attribute = mock_get_vlan_attribute;
+    mock_vlan_api.create_vlan_member = mock_create<SAI_API_VLAN, MOCK_OBJECT_VLAN_MEMBER>;
+    mock_vlan_api.remove_vlan_member = mock_remove<SAI_API_VLAN, MOCK_OBJECT_VLAN_MEMBER>;
+
+    memset(&mock_router_intfs_api, 0, sizeof(mock_router_intfs_api));
+    mock_router_intfs_api.create_router_interface = mock_create<SAI_API_ROUTER_INTERFACE, MOCK_OBJECT_ROUTER_INTERFACE>;
+    mock_router_intfs_api.remove_router_interface = mock_remove<SAI_API_ROUTER_INTERFACE, MOCK_OBJECT_ROUTER_INTERFACE>;
+    mock_router_intfs_api.set_router_interface_attribute = mock_set<SAI_API_ROUTER_INTERFACE, MOCK_OBJECT_ROUTER_INTERFACE>;
+    mock_router_intfs_api.get_router_interface_attribute = mock_get<SAI_API_ROUTER_INTERFACE, MOCK_OBJECT_ROUTER_INTERFACE>;
+
+    memset(&mock_hostif_api, 0, sizeof(mock_hostif_api));
+    mock_hostif_api.create_hostif = mock_create<SAI_API_HOST_INTERFACE, MOCK_OBJECT_HOST_INTERFACE>;
+    mock_hostif_api.remove_hostif = mock_remove<SAI_API_HOST_INTERFACE, MOCK_OBJECT_HOST_INTERFACE>;
+    mock_hostif_api.create_hostif_trap_group = mock_create<SAI_API_HOST_INTERFACE, MOCK_OBJECT_TRAP_GROUP>;
+    mock_hostif_api.remove_hostif_trap_group = mock_remove<SAI_API_HOST_INTERFACE, MOCK_OBJECT_TRAP_GROUP>;
+    mock_hostif_api.set_trap_group_attribute = mock_set<SAI_API_HOST_INTERFACE, MOCK_OBJECT_TRAP_GROUP>;
+    mock_hostif_api.set_trap_attribute = mock_set_trap_attribute;
+
+    memset(&mock_neighbor_api, 0, sizeof(mock_neighbor_api));
+    mock_neighbor_api.create_neighbor_entry = mock_create_neighbor_entry;
+    mock_neighbor_api.remove_neighbor_entry = mock_remove_neighbor_entry;
+
+    memset(&mock_next_hop_api, 0, sizeof(mock_next_hop_api));
+    mock_next_hop_api.create_next_hop = mock_create_next_hop;
+    mock_next_hop_api.remove_next_hop = mock_remove_next_hop;
+    mock_next_hop_api.set_next_hop_attribute = mock_set<SAI_API_NEXT_HOP, MOCK_OBJECT_NEXT_HOP>;
+    mock_next_hop_api.get_next_hop_attribute = mock_get<SAI_API_NEXT_HOP, MOCK_OBJECT_NEXT_HOP>;
+
+    memset(&mock_next_hop_group_api, 0, sizeof(mock_next_hop_group_api));
+    mock_next_hop_group_api.create_next_hop_group = mock_create_next_hop_group;
+    mock_next_hop_group_api.remove_next_hop_group = mock_remove_next_hop_group;
+    mock_next_hop_group_api.add_next_hop_to_group = mock_add_next_hop_to_group;
+    mock_next_hop_group_api.remove_next_hop_from_group = mock_remove_next_hop_from_group;
+
+    memset(&mock_route_api, 0, sizeof(mock_route_api));
+    mock_route_api.create_route = mock_create_route;
+    mock_route_api.remove_route = mock_remove_route;
+    mock_route_api.set_route_attribute = mock_set_route_attribute;
+
+    memset(&mock_lag_api, 0, sizeof(mock_lag_api));
+    mock_lag_api.create_lag = mock_create<SAI_API_LAG, MOCK_OBJECT_LAG>;
+    mock_lag_api.remove_lag = mock_remove<SAI_API_LAG, MOCK_OBJECT_LAG>;
+    mock_lag_api.create_lag_member = mock_create<SAI_API_LAG, MOCK_OBJECT_LAG_MEMBER>;
+    mock_lag_api.remove_lag_member = mock_remove<SAI_API_LAG, MOCK_OBJECT_LAG_MEMBER>;
+
+    memset(&mock_policer_api, 0, sizeof(mock_policer_api));
+    mock_policer_api.create_policer = mock_create<SAI_API_POLICER, MOCK_OBJECT_POLICER>;
+    mock_policer_api.remove_policer = mock_remove<SAI_API_POLICER, MOCK_OBJECT_POLICER>;
+    mock_policer_api.set_policer_attribute = mock_set<SAI_API_POLICER, MOCK_OBJECT_POLICER>;
+    mock_policer_api.get_policer_attribute = mock_get<SAI_API_POLICER, MOCK_OBJECT_POLICER>;
+
+    memset(&mock_tunnel_api, 0, sizeof(mock_tunnel_api));
+    mock_tunnel_api.create_tunnel = mock_create<SAI_API_TUNNEL, MOCK_OBJECT_TUNNEL>;
+    mock_tunnel_api.remove_tunnel = mock_remove<SAI_API_TUNNEL, MOCK_OBJECT_TUNNEL>;
+    mock_tunnel_api.set_tunnel_attribute = mock_set<SAI_API_TUNNEL, MOCK_OBJECT_TUNNEL>;
+    mock_tunnel_api.get_tunnel_attribute = mock_get<SAI_API_TUNNEL, MOCK_OBJECT_TUNNEL>;
+    mock_tunnel_api.create_tunnel_term_table_entry = mock_create<SAI_API_TUNNEL, MOCK_OBJECT_TUNNEL_TERM_TABLE_ENTRY>;
+    mock_tunnel_api.remove_tunnel_term_table_entry = mock_remove<SAI_API_TUNNEL, MOCK_OBJECT_TUNNEL_TERM_TABLE_ENTRY>;
+}
+
+/* The SAI library entry points */
+
+sai_status_t sai_api_initialize(uint64_t flags, const service_method_table_t *services)
+{
+    SWSS_LOG_ENTER();
+
+    const char *value;
+
+    if ((value = getenv("MOCK_SAI_LATENCY_US")) != NULL)
+        mockSaiSetLatency(SAI_API_UNSPECIFIED, (uint32_t)atoi(value));
+    if ((value = getenv("MOCK_SAI_FAILURE_RATE")) != NULL)
+        mockSaiSetFailureRate(SAI_API_UNSPECIFIED, atof(value));
+    if ((value = getenv("MOCK_SAI_PORT_COUNT")) != NULL)
+        mockSaiSetPortCount((uint32_t)atoi(value));
+    if ((value = getenv("MOCK_SAI_ECMP_GROUPS")) != NULL)
+        mockSaiSetEcmpGroupCount((uint32_t)atoi(value));
+
+    initApiTables();
+
+    SWSS_LOG_NOTICE("Initialize mock SAI with %u ports\n", g_portCount);
+
+    return SAI_STATUS_SUCCESS;
+}
+
+sai_status_t sai_api_query(sai_api_t sai_api_id, void **api_method_table)
+{
+    switch (sai_api_id)
+    {
+        case SAI_API_SWITCH:            *api_method_table = &mock_switch_api; break;
+        case SAI_API_VIRTUAL_ROUTER:    *api_method_table = &mock_virtual_router_api; break;
+        case SAI_API_PORT:              *api_method_table = &mock_port_api; break;
+        case SAI_API_VLAN:              *api_method_table = &mock_vlan_api; break;
+        case SAI_API_ROUTER_INTERFACE:  *api_method_table = &mock_router_intfs_api; break;
+        case SAI_API_HOST_INTERFACE:    *api_method_table = &mock_hostif_api; break;
+        case SAI_API_NEIGHBOR:          *api_method_table = &mock_neighbor_api; break;
+        case SAI_API_NEXT_HOP:          *api_method_table = &mock_next_hop_api; break;
+        case SAI_API_NEXT_HOP_GROUP:    *api_method_table = &mock_next_hop_group_api; break;
+        case SAI_API_ROUTE:             *api_method_table = &mock_route_api; break;
+        case SAI_API_LAG:               *api_method_table = &mock_lag_api; break;
+        case SAI_API_POLICER:           *api_method_table = &mock_policer_api; break;
+        case SAI_API_TUNNEL:            *api_method_table = &mock_tunnel_api; break;
+        default:
+            *api_method_table = NULL;
+            return SAI_STATUS_NOT_SUPPORTED;
+    }
+
+    return SAI_STATUS_SUCCESS;
+}
+
+sai_status_t sai_api_uninitialize(void)
+{
+    lock_guard<mutex> lock(g_mutex);
+
+    createSwitch();
+    return SAI_STATUS_SUCCESS;
+}
+
+sai_status_t sai_log_set(sai_api_t sai_api_id, sai_log_level_t log_level)
+{
+    return SAI_STATUS_SUCCESS;
+}
+
+/* Configuration and statistics */
+
+void mockSaiSetLatency(sai_api_t api, uint32_t latencyUs)
+{
+    for (int i = 0; i < MOCK_SAI_API_MAX; i++)
+    {
+        if (api == SAI_API_UNSPECIFIED || i == api)
+            g_apiConfig[i].latency_us.store(latencyUs, memory_order_relaxed);
+    }
+}
+
+void mockSaiSetFailureRate(sai_api_t api, double rate, sai_status_t status)
+{
+    uint32_t ppm = rate <= 0 ? 0 : rate >= 1 ? 1000000 : (uint32_t)(rate * 1000000);
+
+    for (int i = 0; i < MOCK_SAI_API_MAX; i++)
+    {
+        if (api == SAI_API_UNSPECIFIED || i == api)
+        {
+            g_apiConfig[i].failure_status.store(status, memory_order_relaxed);
+            g_apiConfig[i].failure_ppm.store(ppm, memory_order_relaxed);
+        }
+    }
+}
+
+void mockSaiSetPortCount(uint32_t count)
+{
+    g_portCount = count;
+}
+
+void mockSaiSetEcmpGroupCount(uint32_t count)
+{
+    g_maxEcmpGroups = count;
+}
+
+uint64_t mockSaiGetCallCount(sai_api_t api)
+{
+    return g_apiConfig[api].calls.load(memory_order_relaxed);
+}
+
+uint64_t mockSaiGetFailureCount(sai_api_t api)
+{
+    return g_apiConfig[api].failures.load(memory_order_relaxed);
+}
+
+size_t mockSaiGetRouteCount()
+{
+    lock_guard<mutex> lock(g_mutex);
+    return g_routes.size();
+}
+
+size_t mockSaiGetNeighborCount()
+{
+    lock_guard<mutex> lock(g_mutex);
+    return g_neighbors.size();
+}
+
+size_t mockSaiGetObjectCount()
+{
+    lock_guard<mutex> lock(g_mutex);
+    return g_objects.size();
+}
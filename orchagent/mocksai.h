@@ -0,0 +1,48 @@
+#ifndef SWSS_MOCKSAI_H
+#define SWSS_MOCKSAI_H
+
+extern "C" {
+#include "sai.h"
+#include "saistatus.h"
+}
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The mock SAI library implements sai_api_initialize(), sai_api_query()
+ * and the API tables used by orchagent in memory, in place of libsairedis.
+ * It is linked into the benchmark builds so that the orchestration can be
+ * measured without a switch or syncd.
+ *
+ * Every call can be delayed by a busy wait of the configured latency and
+ * can fail with the configured status at the configured rate. Both are
+ * set per API, SAI_API_UNSPECIFIED setting them for every API. They are
+ * read from the environment by sai_api_initialize():
+ *
+ *   MOCK_SAI_LATENCY_US    latency of every call in microseconds
+ *   MOCK_SAI_FAILURE_RATE  rate of the calls failing, between 0 and 1
+ *   MOCK_SAI_PORT_COUNT    number of front panel ports, 4 lanes each
+ *   MOCK_SAI_ECMP_GROUPS   number of next hop groups that can be created
+ */
+
+#define MOCK_SAI_DEFAULT_PORT_COUNT     32
+#define MOCK_SAI_DEFAULT_ECMP_GROUPS    128
+#define MOCK_SAI_DEFAULT_ECMP_MEMBERS   64
+#define MOCK_SAI_LANES_PER_PORT         4
+
+void mockSaiSetLatency(sai_api_t api, uint32_t latencyUs);
+void mockSaiSetFailureRate(sai_api_t api, double rate, sai_status_t status = SAI_STATUS_FAILURE);
+
+/* Must be called before sai_api_initialize() creates the switch */
+void mockSaiSetPortCount(uint32_t count);
+void mockSaiSetEcmpGroupCount(uint32_t count);
+
+uint64_t mockSaiGetCallCount(sai_api_t api);
+uint64_t mockSaiGetFailureCount(sai_api_t api);
+
+size_t mockSaiGetRouteCount();
+size_t mockSaiGetNeighborCount();
+size_t mockSaiGetObjectCount();
+
+#endif /* SWSS_MOCKSAI_H */
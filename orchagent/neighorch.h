@@ -2,6 +2,7 @@
 #define SWSS_NEIGHORCH_H
 
 #include "orch.h"
+#include "observer.h"
 #include "portsorch.h"
 
 #include "ipaddress.h"
@@ -23,12 +24,18 @@ struct NextHopEntry
     int                 ref_count;      // reference count
 };
 
+struct NextHopUpdate
+{
+    IpAddress           ip_address;     // next hop IP address
+    bool                add;            // next hop is added or removed
+};
+
 /* NeighborTable: NeighborEntry, neighbor MAC address */
 typedef map<NeighborEntry, MacAddress> NeighborTable;
 /* NextHopTable: next hop IP address, NextHopEntry */
 typedef map<IpAddress, NextHopEntry> NextHopTable;
 
-class NeighOrch : public Orch
+class NeighOrch : public Orch, public Subject
 {
 public:
     NeighOrch(DBConnector *db, string tableName, PortsOrch *portsOrch) :
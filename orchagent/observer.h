@@ -0,0 +1,48 @@
+#ifndef SWSS_OBSERVER_H
+#define SWSS_OBSERVER_H
+
+#include <list>
+
+using namespace std;
+
+enum SubjectType
+{
+    SUBJECT_TYPE_NONE,
+    SUBJECT_TYPE_NEXTHOP_CHANGE,
+};
+
+class Observer
+{
+public:
+    virtual void update(SubjectType, void *) = 0;
+    virtual ~Observer() {}
+};
+
+class Subject
+{
+public:
+    virtual void attach(Observer *observer)
+    {
+        m_observers.push_back(observer);
+    }
+
+    virtual void detach(Observer *observer)
+    {
+        m_observers.remove(observer);
+    }
+
+    virtual ~Subject() {}
+
+protected:
+    list<Observer *> m_observers;
+
+    virtual void notify(SubjectType type, void *cntx)
+    {
+        for (auto iter : m_observers)
+        {
+            iter->update(type, cntx);
+        }
+    }
+};
+
+#endif /* SWSS_OBSERVER_H */
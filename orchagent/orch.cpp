@@ -1,5 +1,6 @@
 #include "orch.h"
 #include "logger.h"
+#include "common/recorder.h"
 #include <iostream>
 using namespace swss;
 
@@ -27,23 +28,13 @@ Orch::~Orch()
     }
 }
 
-std::vector<Selectable *> Orch::getSelectables()
+std::vector<Consumer *> Orch::getConsumers()
 {
-    std::vector<Selectable *> selectables;
-    for(auto it : m_consumerMap) {
-        selectables.push_back(it.second.m_consumer);
-    }
-    return selectables;
-}
-
-bool Orch::hasSelectable(ConsumerTable *selectable) const
-{
-    for(auto it : m_consumerMap) {
-        if(it.second.m_consumer == selectable) {
-            return true;
-        }
+    std::vector<Consumer *> consumers;
+    for(auto &it : m_consumerMap) {
+        consumers.push_back(&it.second);
     }
-    return false;
+    return consumers;
 }
 
 bool Orch::execute(string tableName)
@@ -55,21 +46,73 @@ bool Orch::execute(string tableName)
         SWSS_LOG_ERROR("Unrecognized tableName:%s\n", tableName.c_str());
         return false;
     }
-    Consumer& consumer = consumer_it->second;
 
-    KeyOpFieldsValuesTuple new_data;
-    consumer.m_consumer->pop(new_data);
+    return execute(consumer_it->second);
+}
+
+bool Orch::execute(Consumer &consumer)
+{
+    SWSS_LOG_ENTER();
+
+    /*
+     * The select wakeup guarantees one task is available. Keep popping as
+     * long as the consumer table has more notifications cached, up to
+     * gBatchSize tasks, so that doTask runs once per batch instead of once
+     * per task.
+     */
+    int count = 0;
+    do
+    {
+        KeyOpFieldsValuesTuple new_data;
+        consumer.m_consumer->pop(new_data);
+        Recorder::getInstance().record(consumer.m_consumer->getTableName(), new_data);
+
+        addToSync(consumer, new_data);
+        count++;
+    }
+    while (count < gBatchSize &&
+           consumer.m_consumer->readCache() == Selectable::DATA);
+
+    consumer.m_stats.popped += count;
+
+    if (!consumer.m_toSync.empty())
+        runTask(consumer);
 
+    return true;
+}
+
+void Orch::addToSync(Consumer &consumer, KeyOpFieldsValuesTuple &new_data)
+{
     string key = kfvKey(new_data);
     string op  = kfvOp(new_data);
 
 #ifdef DEBUG
-    string debug = "Table : " + consumer.m_consumer.getTableName() + " key : " + kfvKey(new_data) + " op : "  + kfvOp(new_data);
+    string debug = "Table : " + consumer.m_consumer->getTableName() + " key : " + kfvKey(new_data) + " op : "  + kfvOp(new_data);
     for (auto i : kfvFieldsValues(new_data))
         debug += " " + fvField(i) + " : " + fvValue(i);
     SWSS_LOG_DEBUG("%s\n", debug.c_str());
 #endif
 
+    /* A task waiting for retry is touched again, process it in the next pass */
+    auto retry_it = consumer.m_toRetry.find(key);
+
+    /* A key already pending keeps the time its oldest task was queued */
+    auto now = chrono::steady_clock::now();
+    if (retry_it != consumer.m_toRetry.end() ||
+        consumer.m_toSync.find(key) != consumer.m_toSync.end() ||
+        isParked(consumer, key))
+    {
+        consumer.m_queued.emplace(key, now);
+    }
+    else
+        consumer.m_queued[key] = now;
+
+    if (retry_it != consumer.m_toRetry.end())
+    {
+        consumer.m_toSync[key] = retry_it->second;
+        consumer.m_toRetry.erase(retry_it);
+    }
+
     /* If a new task comes or if a DEL task comes, we directly put it into consumer.m_toSync map */
     if ( consumer.m_toSync.find(key) == consumer.m_toSync.end() || op == DEL_COMMAND)
     {
@@ -102,19 +145,167 @@ bool Orch::execute(string tableName)
         }
         consumer.m_toSync[key] = KeyOpFieldsValuesTuple(key, op, existing_values);
     }
+}
 
-    if (!consumer.m_toSync.empty())
-        doTask(consumer);
+void Orch::runTask(Consumer &consumer)
+{
+    ConsumerStats &stats = consumer.m_stats;
 
-    return true;
+    auto start = chrono::steady_clock::now();
+    doTask(consumer);
+    auto end = chrono::steady_clock::now();
+
+    uint64_t duration = chrono::duration_cast<chrono::microseconds>(end - start).count();
+    size_t i = 0;
+    while (i < PASS_DURATION_BUCKETS - 1 && duration >= pass_duration_buckets[i])
+        i++;
+    stats.pass_durations[i]++;
+    stats.passes++;
+    stats.retried += consumer.m_toSync.size();
+
+    if (consumer.m_queued.size() > consumer.m_queuedLimit)
+        pruneQueued(consumer);
+
+    /*
+     * Whatever doTask left in m_toSync could not be processed this time.
+     * Park it in m_toRetry so that the next pass only walks the tasks that
+     * are touched again, instead of rescanning the whole backlog.
+     */
+    if (consumer.m_toSync.empty())
+        return;
+
+    if (consumer.m_toRetry.empty())
+    {
+        consumer.m_retryDelay = chrono::milliseconds(RETRY_MIN_DELAY_MS);
+        consumer.m_retryDue = end + consumer.m_retryDelay;
+        consumer.m_toRetry.swap(consumer.m_toSync);
+        return;
+    }
+
+    for (auto &it : consumer.m_toSync)
+        consumer.m_toRetry[it.first] = it.second;
+    consumer.m_toSync.clear();
+}
+
+void Orch::pruneQueued(Consumer &consumer)
+{
+    auto it = consumer.m_queued.begin();
+    while (it != consumer.m_queued.end())
+    {
+        if (consumer.m_toSync.find(it->first) == consumer.m_toSync.end() &&
+            consumer.m_toRetry.find(it->first) == consumer.m_toRetry.end() &&
+            !isParked(consumer, it->first))
+        {
+            it = consumer.m_queued.erase(it);
+        }
+        else
+            it++;
+    }
+
+    /* Prune again once the map doubles, keeping the cost per queued task constant */
+    consumer.m_queuedLimit = 2 * consumer.m_queued.size() + gBatchSize;
 }
 
 void Orch::doTask()
+{
+    auto now = chrono::steady_clock::now();
+
+    for(auto &it : m_consumerMap)
+    {
+        Consumer &consumer = it.second;
+
+        if (consumer.m_toRetry.empty() || now < consumer.m_retryDue)
+            continue;
+
+        size_t count = consumer.m_toRetry.size();
+        auto delay = consumer.m_retryDelay;
+
+        /* Tasks already in m_toSync are newer than the ones waiting for retry */
+        if (consumer.m_toSync.empty())
+            consumer.m_toSync.swap(consumer.m_toRetry);
+        else
+        {
+            consumer.m_toSync.insert(consumer.m_toRetry.begin(), consumer.m_toRetry.end());
+            consumer.m_toRetry.clear();
+        }
+
+        runTask(consumer);
+
+        /* Back off while the left over tasks keep failing */
+        if (consumer.m_toRetry.size() >= count)
+            delay = min(delay * 2, chrono::milliseconds(RETRY_MAX_DELAY_MS));
+        else
+            delay = chrono::milliseconds(RETRY_MIN_DELAY_MS);
+
+        consumer.m_retryDelay = delay;
+        consumer.m_retryDue = chrono::steady_clock::now() + delay;
+    }
+}
+
+chrono::steady_clock::time_point Orch::getRetryDue() const
+{
+    auto due = chrono::steady_clock::time_point::max();
+
+    for(auto &it : m_consumerMap)
+    {
+        if (!it.second.m_toRetry.empty())
+            due = min(due, it.second.m_retryDue);
+    }
+
+    return due;
+}
+
+void Orch::doPendingTask()
 {
     for(auto &it : m_consumerMap)
     {
         if (!it.second.m_toSync.empty())
-            doTask(it.second);
+            runTask(it.second);
+    }
+}
+
+void Orch::publishStats(Table &table, double interval)
+{
+    auto now = chrono::steady_clock::now();
+
+    for (auto &it : m_consumerMap)
+    {
+        Consumer &consumer = it.second;
+        ConsumerStats &stats = consumer.m_stats;
+
+        /* Report the age of the oldest task still pending, parked ones included */
+        pruneQueued(consumer);
+
+        uint64_t backlog_age = 0;
+        for (auto &it_queued : consumer.m_queued)
+        {
+            uint64_t age = chrono::duration_cast<chrono::milliseconds>(now - it_queued.second).count();
+            backlog_age = max(backlog_age, age);
+        }
+
+        uint64_t popped_per_sec = 0;
+        if (interval > 0)
+            popped_per_sec = (uint64_t)((stats.popped - stats.published_popped) / interval);
+        stats.published_popped = stats.popped;
+
+        vector<FieldValueTuple> fvs;
+        fvs.push_back(FieldValueTuple("POPPED", to_string(stats.popped)));
+        fvs.push_back(FieldValueTuple("POPPED_PER_SEC", to_string(popped_per_sec)));
+        fvs.push_back(FieldValueTuple("TO_SYNC", to_string(consumer.m_toSync.size())));
+        fvs.push_back(FieldValueTuple("TO_RETRY", to_string(consumer.m_toRetry.size())));
+        fvs.push_back(FieldValueTuple("BACKLOG_AGE_MS", to_string(backlog_age)));
+        fvs.push_back(FieldValueTuple("PASSES", to_string(stats.passes)));
+        fvs.push_back(FieldValueTuple("RETRIED", to_string(stats.retried)));
+
+        for (size_t i = 0; i < PASS_DURATION_BUCKETS; i++)
+        {
+            string field = i < PASS_DURATION_BUCKETS - 1 ?
+                    "PASS_DURATION_LT_" + to_string(pass_duration_buckets[i]) + "US" :
+                    "PASS_DURATION_GE_" + to_string(pass_duration_buckets[i - 1]) + "US";
+            fvs.push_back(FieldValueTuple(field, to_string(stats.pass_durations[i])));
+        }
+
+        table.set(it.first, fvs);
     }
 }
 
@@ -9,8 +9,10 @@ extern "C" {
 #include "dbconnector.h"
 #include "consumertable.h"
 #include "producertable.h"
+#include "table.h"
 
 #include <map>
+#include <chrono>
 
 using namespace std;
 using namespace swss;
@@ -18,6 +20,19 @@ using namespace swss;
 const char delimiter           = ':';
 const char list_item_delimiter = ',';
 
+/* Default maximum number of tasks popped from a consumer table per wakeup */
+#define DEFAULT_BATCH_SIZE  128
+
+extern int gBatchSize;
+
+/*
+ * Delay in milliseconds before the left over tasks of a consumer are
+ * retried. It doubles up to RETRY_MAX_DELAY_MS after every retry pass
+ * that makes no progress.
+ */
+#define RETRY_MIN_DELAY_MS  10
+#define RETRY_MAX_DELAY_MS  1000
+
 typedef enum
 {
     task_success,
@@ -30,11 +45,37 @@ typedef enum
 typedef std::map<string, sai_object_id_t> object_map;
 typedef std::pair<string, sai_object_id_t> object_map_pair;
 typedef map<string, KeyOpFieldsValuesTuple> SyncMap;
+
+/* Upper bounds in microseconds of the doTask pass duration buckets */
+const uint64_t pass_duration_buckets[] = { 100, 1000, 10000, 100000, 1000000 };
+#define PASS_DURATION_BUCKETS   (sizeof(pass_duration_buckets) / sizeof(pass_duration_buckets[0]) + 1)
+
+struct ConsumerStats
+{
+    uint64_t popped;                                // tasks popped from the consumer table
+    uint64_t passes;                                // doTask passes run
+    uint64_t retried;                               // tasks left over by the passes
+    uint64_t pass_durations[PASS_DURATION_BUCKETS]; // passes per duration bucket
+    uint64_t published_popped;                      // popped value last published
+};
+
+typedef map<string, chrono::steady_clock::time_point> QueuedTimeMap;
+
 struct Consumer {
-    Consumer(ConsumerTable* consumer) :m_consumer(consumer)  { }
+    Consumer(ConsumerTable* consumer) :m_consumer(consumer), m_queuedLimit(0),
+        m_retryDelay(RETRY_MIN_DELAY_MS), m_stats() { }
     ConsumerTable* m_consumer;
-    /* Store the latest 'golden' status */
+    /* Store the latest 'golden' status of tasks touched since the last pass */
     SyncMap m_toSync;
+    /* Store the tasks left over by earlier passes, waiting to be retried */
+    SyncMap m_toRetry;
+    /* Store the time each pending task was first queued, completed ones are pruned lazily */
+    QueuedTimeMap m_queued;
+    size_t m_queuedLimit;
+    /* Time the tasks in m_toRetry are due, and the delay used to schedule it */
+    chrono::steady_clock::time_point m_retryDue;
+    chrono::milliseconds m_retryDelay;
+    ConsumerStats m_stats;
 };
 typedef std::pair<string, Consumer> ConsumerMapPair;
 typedef map<string, Consumer> ConsumerMap;
@@ -46,19 +87,35 @@ public:
     Orch(DBConnector *db, vector<string> &tableNames);
     virtual ~Orch();
 
-    std::vector<Selectable*> getSelectables();
-    bool hasSelectable(ConsumerTable* s) const;
+    std::vector<Consumer*> getConsumers();
 
     bool execute(string tableName);
-    /* Iterate all consumers in m_consumerMap and run doTask(Consumer) */
+    /* Pop a batch of tasks from the consumer and run doTask(Consumer) */
+    bool execute(Consumer &consumer);
+    /* Retry the left over tasks of the consumers in m_consumerMap whose retry is due */
     void doTask();
+    /* Time the first retry is due, time_point::max() when nothing is left over */
+    chrono::steady_clock::time_point getRetryDue() const;
+    /* Run doTask(Consumer) on consumers with tasks woken up outside execute() */
+    virtual void doPendingTask();
+    /* Write the statistics of every consumer into table, interval is in seconds */
+    void publishStats(Table &table, double interval);
 protected:
     /* Run doTask against a specific consumer */
     virtual void doTask(Consumer &consumer) = 0;
+    /* Tell whether the orch holds the task of key outside m_toSync and m_toRetry */
+    virtual bool isParked(Consumer &consumer, const string &key) { return false; }
     void dumpTuple(Consumer &consumer, KeyOpFieldsValuesTuple &tuple);
 private:
     DBConnector *m_db;
 
+    /* Merge a newly popped task into consumer.m_toSync */
+    void addToSync(Consumer &consumer, KeyOpFieldsValuesTuple &entry);
+    /* Run doTask(Consumer) and move the tasks it left into consumer.m_toRetry */
+    void runTask(Consumer &consumer);
+    /* Forget the queued time of the tasks no longer pending */
+    void pruneQueued(Consumer &consumer);
+
 protected:
     ConsumerMap m_consumerMap;
 
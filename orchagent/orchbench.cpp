@@ -0,0 +1,606 @@
+#include "orchdaemon.h"
+#include "mocksai.h"
+
+#include "logger.h"
+
+extern "C" {
+#include "sai.h"
+#include "saistatus.h"
+}
+
+#include <hiredis/hiredis.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <getopt.h>
+
+using namespace std;
+using namespace swss;
+
+/* The global API pointers and switch state used by the orchs */
+sai_switch_api_t*           sai_switch_api;
+sai_virtual_router_api_t*   sai_virtual_router_api;
+sai_port_api_t*             sai_port_api;
+sai_vlan_api_t*             sai_vlan_api;
+sai_router_interface_api_t* sai_router_intfs_api;
+sai_hostif_api_t*           sai_hostif_api;
+sai_neighbor_api_t*         sai_neighbor_api;
+sai_next_hop_api_t*         sai_next_hop_api;
+sai_next_hop_group_api_t*   sai_next_hop_group_api;
+sai_route_api_t*            sai_route_api;
+sai_lag_api_t*              sai_lag_api;
+sai_policer_api_t*          sai_policer_api;
+sai_tunnel_api_t*           sai_tunnel_api;
+
+sai_object_id_t gVirtualRouterId;
+sai_object_id_t underlayIfId;
+MacAddress gMacAddress;
+
+int gBatchSize = DEFAULT_BATCH_SIZE;
+
+/* Redis database used by the benchmark, flushed at start */
+#define DEFAULT_BENCH_DB        7
+#define DEFAULT_ROUTE_COUNTS    "100000"
+#define DEFAULT_NEIGHBOR_COUNT  8
+#define DEFAULT_FLAP_COUNT      10
+
+/* Time in seconds after which a scenario that does not converge is given up */
+#define BENCH_TIMEOUT           600
+
+static int64_t nowUs()
+{
+    return chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct BenchResult
+{
+    string              name;           // scenario name
+    size_t              tasks;          // tasks or events driven
+    double              seconds;        // time until the orchs converged
+    vector<int64_t>     latencies;      // per task or event latency in microseconds
+    bool                converged;      // the SAI state is the expected one
+};
+
+/*
+ * OrchBench drives PortsOrch, IntfsOrch, NeighOrch and RouteOrch through
+ * Orch::execute() the way OrchDaemon::run() does, with the tasks written
+ * to a local Redis by producer tables and the SAI calls served by the
+ * mock SAI library.
+ *
+ * The IPv4 routes are /24s out of 11.0.0.0/8 onwards. One out of four
+ * points to the first neighbor, the others to an ECMP group of all the
+ * other neighbors. Each neighbor sits on its own port and /31 interface.
+ */
+class OrchBench
+{
+public:
+    OrchBench(int db, int neighbors);
+
+    void setup();
+
+    BenchResult addRoutes(size_t count);
+    BenchResult withdrawRoutes(size_t count);
+    BenchResult flapEcmpMember(size_t count, int flaps);
+    BenchResult flapNeighbor(size_t count, int flaps);
+    BenchResult resyncRoutes(size_t count);
+
+private:
+    int m_dbId;
+    int m_neighbors;
+
+    DBConnector m_db;
+    ProducerTable m_portTable;
+    ProducerTable m_intfTable;
+    ProducerTable m_neighTable;
+
+    vector<Orch *> m_orchs;
+    EpollSelect m_select;
+    ConsumerIndex m_consumerIndex;
+    Consumer *m_routeConsumer;
+
+    size_t m_baseRoutes;                // interface routes
+    string m_ecmpNextHops;
+    string m_ecmpIfnames;
+
+    string getAlias(int neighbor);
+    string getNeighborIp(int neighbor);
+    string getPrefix(size_t route);
+    bool isEcmpRoute(size_t route) { return route % 4 != 0; }
+    size_t getSingleRouteCount(size_t count) { return (count + 3) / 4; }
+
+    void setNeighbor(int neighbor);
+    void setRoute(ProducerTable &table, size_t route);
+
+    /* Run one iteration of the orch loop of OrchDaemon, true when select timed out */
+    bool poll(int timeout);
+    bool hasPendingTask();
+    /* Run the orch loop until it is idle and done() holds */
+    bool drain(function<bool()> done);
+
+    /* Write count route tasks from a producer thread while running the orch loop */
+    BenchResult stream(string name, size_t count,
+                       function<void(ProducerTable &, size_t)> task,
+                       function<bool()> done);
+    /* Flap a neighbor, waiting for convergence after each DEL and SET */
+    BenchResult flap(string name, int neighbor, int flaps,
+                     size_t downRoutes, size_t upRoutes);
+};
+
+OrchBench::OrchBench(int db, int neighbors) :
+    m_dbId(db),
+    m_neighbors(neighbors),
+    m_db(db, "localhost", 6379, 0),
+    m_portTable(&m_db, APP_PORT_TABLE_NAME),
+    m_intfTable(&m_db, APP_INTF_TABLE_NAME),
+    m_neighTable(&m_db, APP_NEIGH_TABLE_NAME),
+    m_routeConsumer(nullptr),
+    m_baseRoutes(0)
+{
+    redisReply *reply = (redisReply *)redisCommand(m_db.getContext(), "FLUSHDB");
+    if (reply)
+        freeReplyObject(reply);
+
+    /* Every orch owns its database connection */
+    vector<string> ports_tables = {
+        APP_PORT_TABLE_NAME,
+        APP_VLAN_TABLE_NAME,
+        APP_LAG_TABLE_NAME
+    };
+
+    PortsOrch *ports_orch = new PortsOrch(new DBConnector(db, "localhost", 6379, 0), ports_tables);
+    IntfsOrch *intfs_orch = new IntfsOrch(new DBConnector(db, "localhost", 6379, 0), APP_INTF_TABLE_NAME, ports_orch);
+    NeighOrch *neigh_orch = new NeighOrch(new DBConnector(db, "localhost", 6379, 0), APP_NEIGH_TABLE_NAME, ports_orch);
+    RouteOrch *route_orch = new RouteOrch(new DBConnector(db, "localhost", 6379, 0), APP_ROUTE_TABLE_NAME, ports_orch, neigh_orch);
+
+    m_orchs = { ports_orch, intfs_orch, neigh_orch, route_orch };
+
+    for (Orch *o : m_orchs)
+    {
+        for (Consumer *c : o->getConsumers())
+        {
+            m_consumerIndex[c->m_consumer] = make_pair(o, c);
+            m_select.addSelectable(c->m_consumer);
+
+            if (o == route_orch)
+                m_routeConsumer = c;
+        }
+    }
+
+    for (int i = 1; i < m_neighbors; i++)
+    {
+        m_ecmpNextHops += getNeighborIp(i) + (i + 1 < m_neighbors ? "," : "");
+        m_ecmpIfnames += getAlias(i) + (i + 1 < m_neighbors ? "," : "");
+    }
+}
+
+string OrchBench::getAlias(int neighbor)
+{
+    return "Ethernet" + to_string(neighbor * MOCK_SAI_LANES_PER_PORT);
+}
+
+string OrchBench::getNeighborIp(int neighbor)
+{
+    return "10.0." + to_string(neighbor) + ".1";
+}
+
+string OrchBench::getPrefix(size_t route)
+{
+    uint32_t addr = 0x0B000000 + ((uint32_t)route << 8);
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%u.%u.%u.0/24",
+             addr >> 24, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF);
+    return prefix;
+}
+
+void OrchBench::setNeighbor(int neighbor)
+{
+    char mac[32];
+    snprintf(mac, sizeof(mac), "00:00:00:00:01:%02x", neighbor);
+
+    vector<FieldValueTuple> fvs = {
+        FieldValueTuple("neigh", mac),
+        FieldValueTuple("family", "IPv4")
+    };
+    m_neighTable.set(getAlias(neighbor) + ":" + getNeighborIp(neighbor), fvs);
+}
+
+void OrchBench::setRoute(ProducerTable &table, size_t route)
+{
+    vector<FieldValueTuple> fvs;
+
+    if (isEcmpRoute(route))
+    {
+        fvs.push_back(FieldValueTuple("nexthop", m_ecmpNextHops));
+        fvs.push_back(FieldValueTuple("ifname", m_ecmpIfnames));
+    }
+    else
+    {
+        fvs.push_back(FieldValueTuple("nexthop", getNeighborIp(0)));
+        fvs.push_back(FieldValueTuple("ifname", getAlias(0)));
+    }
+
+    table.set(getPrefix(route), fvs);
+}
+
+bool OrchBench::poll(int timeout)
+{
+    return runOrchLoopStep(m_select, m_consumerIndex, m_orchs, timeout) == EpollSelect::TIMEOUT;
+}
+
+bool OrchBench::hasPendingTask()
+{
+    for (auto &it : m_consumerIndex)
+    {
+        if (!it.second.second->m_toSync.empty())
+            return true;
+    }
+
+    return false;
+}
+
+bool OrchBench::drain(function<bool()> done)
+{
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(BENCH_TIMEOUT);
+
+    while (chrono::steady_clock::now() < deadline)
+    {
+        if (poll(1) && !hasPendingTask() && done())
+            return true;
+    }
+
+    return false;
+}
+
+void OrchBench::setup()
+{
+    SWSS_LOG_ENTER();
+
+    vector<FieldValueTuple> fvs = { FieldValueTuple("count", to_string(m_neighbors)) };
+    m_portTable.set("ConfigDone", fvs);
+    drain([]() { return true; });
+
+    for (int i = 0; i < m_neighbors; i++)
+    {
+        stringstream lanes;
+        for (int j = 0; j < MOCK_SAI_LANES_PER_PORT; j++)
+            lanes << (j ? "," : "") << i * MOCK_SAI_LANES_PER_PORT + j + 1;
+
+        fvs = {
+            FieldValueTuple("lanes", lanes.str()),
+            FieldValueTuple("admin_status", "up")
+        };
+        m_portTable.set(getAlias(i), fvs);
+    }
+    drain([]() { return true; });
+
+    for (int i = 0; i < m_neighbors; i++)
+    {
+        fvs = {
+            FieldValueTuple("scope", "global"),
+            FieldValueTuple("family", "IPv4")
+        };
+        m_intfTable.set(getAlias(i) + ":10.0." + to_string(i) + ".0/31", fvs);
+    }
+
+    /* A subnet route and an ip2me route per interface */
+    m_baseRoutes = mockSaiGetRouteCount() + 2 * m_neighbors;
+    drain([this]() { return mockSaiGetRouteCount() == m_baseRoutes; });
+
+    for (int i = 0; i < m_neighbors; i++)
+        setNeighbor(i);
+    drain([this]() { return mockSaiGetNeighborCount() == (size_t)m_neighbors; });
+}
+
+BenchResult OrchBench::stream(string name, size_t count,
+                              function<void(ProducerTable &, size_t)> task,
+                              function<bool()> done)
+{
+    BenchResult result;
+    result.name = name;
+    result.tasks = count;
+    result.latencies.reserve(count);
+
+    vector<int64_t> written_at(count);
+    atomic<size_t> written(0);
+
+    int64_t start = nowUs();
+
+    thread producer([this, count, &task, &written_at, &written]() {
+        DBConnector db(m_dbId, "localhost", 6379, 0);
+        ProducerTable table(&db, APP_ROUTE_TABLE_NAME);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            written_at[i] = nowUs();
+            task(table, i);
+            written.store(i + 1, memory_order_release);
+        }
+    });
+
+    /*
+     * The consumer table pops the tasks in the order they are written, so
+     * the n-th task popped is the n-th written. A task is done when the
+     * execute() that popped it returns.
+     */
+    uint64_t base = m_routeConsumer->m_stats.popped;
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(BENCH_TIMEOUT);
+
+    while (result.latencies.size() < count && chrono::steady_clock::now() < deadline)
+    {
+        poll(1);
+
+        size_t popped = min<size_t>(m_routeConsumer->m_stats.popped - base,
+                                    written.load(memory_order_acquire));
+        int64_t now = nowUs();
+        while (result.latencies.size() < popped)
+            result.latencies.push_back(now - written_at[result.latencies.size()]);
+    }
+
+    producer.join();
+
+    result.converged = result.latencies.size() == count && drain(done);
+    result.seconds = (nowUs() - start) / 1e6;
+    return result;
+}
+
+BenchResult OrchBench::flap(string name, int neighbor, int flaps,
+                            size_t downRoutes, size_t upRoutes)
+{
+    BenchResult result;
+    result.name = name;
+    result.tasks = 2 * flaps;
+    result.converged = true;
+
+    int64_t start = nowUs();
+
+    for (int i = 0; i < flaps && result.converged; i++)
+    {
+        int64_t down = nowUs();
+        m_neighTable.del(getAlias(neighbor) + ":" + getNeighborIp(neighbor));
+        result.converged = drain([this, downRoutes]() {
+            return mockSaiGetNeighborCount() == (size_t)m_neighbors - 1 &&
+                   mockSaiGetRouteCount() == downRoutes;
+        });
+        result.latencies.push_back(nowUs() - down);
+
+        int64_t up = nowUs();
+        setNeighbor(neighbor);
+        result.converged = result.converged && drain([this, upRoutes]() {
+            return mockSaiGetNeighborCount() == (size_t)m_neighbors &&
+                   mockSaiGetRouteCount() == upRoutes;
+        });
+        result.latencies.push_back(nowUs() - up);
+    }
+
+    result.seconds = (nowUs() - start) / 1e6;
+    return result;
+}
+
+BenchResult OrchBench::addRoutes(size_t count)
+{
+    return stream("add " + to_string(count), count,
+            [this](ProducerTable &table, size_t i) { setRoute(table, i); },
+            [this, count]() { return mockSaiGetRouteCount() == m_baseRoutes + count; });
+}
+
+BenchResult OrchBench::withdrawRoutes(size_t count)
+{
+    return stream("withdraw " + to_string(count), count,
+            [this](ProducerTable &table, size_t i) { table.del(getPrefix(i)); },
+            [this]() { return mockSaiGetRouteCount() == m_baseRoutes; });
+}
+
+BenchResult OrchBench::flapEcmpMember(size_t count, int flaps)
+{
+    /* The last neighbor is a member of the ECMP group, no route changes */
+    size_t routes = m_baseRoutes + count;
+    return flap("ecmp member flap " + to_string(count), m_neighbors - 1, flaps, routes, routes);
+}
+
+BenchResult OrchBench::flapNeighbor(size_t count, int flaps)
+{
+    /* The routes through the first neighbor are removed and restored */
+    size_t routes = m_baseRoutes + count;
+    return flap("neighbor flap " + to_string(count), 0, flaps,
+                routes - getSingleRouteCount(count), routes);
+}
+
+BenchResult OrchBench::resyncRoutes(size_t count)
+{
+    /* Announce nine out of ten routes again, the others are stale */
+    vector<size_t> announced;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i % 10)
+            announced.push_back(i);
+    }
+
+    size_t stale = count - announced.size();
+
+    return stream("resync " + to_string(count), announced.size() + 2,
+            [this, &announced](ProducerTable &table, size_t i) {
+                vector<FieldValueTuple> fvs = { FieldValueTuple("nexthop", "0.0.0.0") };
+                if (i == 0)
+                    table.set("resync", fvs);
+                else if (i == announced.size() + 1)
+                    table.del("resync");
+                else
+                    setRoute(table, announced[i - 1]);
+            },
+            [this, count, stale]() { return mockSaiGetRouteCount() == m_baseRoutes + count - stale; });
+}
+
+static void printHeader()
+{
+    /* The RSS column is the peak of the process so far, not of the scenario alone */
+    printf("%-28s %10s %10s %12s %10s %10s %12s %s\n",
+           "scenario", "tasks", "seconds", "tasks/s", "p50(us)", "p99(us)", "peakrss(MB)", "");
+}
+
+static void printResult(BenchResult &result)
+{
+    sort(result.latencies.begin(), result.latencies.end());
+
+    int64_t p50 = 0, p99 = 0;
+    if (!result.latencies.empty())
+    {
+        p50 = result.latencies[(result.latencies.size() - 1) * 50 / 100];
+        p99 = result.latencies[(result.latencies.size() - 1) * 99 / 100];
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("%-28s %10zu %10.3f %12.0f %10lld %10lld %12.1f %s\n",
+           result.name.c_str(), result.tasks, result.seconds,
+           result.seconds > 0 ? result.tasks / result.seconds : 0,
+           (long long)p50, (long long)p99, usage.ru_maxrss / 1024.0,
+           result.converged ? "" : "NOT CONVERGED");
+    fflush(stdout);
+}
+
+static bool initSai()
+{
+    sai_api_initialize(0, NULL);
+
+    sai_api_query(SAI_API_SWITCH,               (void **)&sai_switch_api);
+    sai_api_query(SAI_API_VIRTUAL_ROUTER,       (void **)&sai_virtual_router_api);
+    sai_api_query(SAI_API_PORT,                 (void **)&sai_port_api);
+    sai_api_query(SAI_API_VLAN,                 (void **)&sai_vlan_api);
+    sai_api_query(SAI_API_HOST_INTERFACE,       (void **)&sai_hostif_api);
+    sai_api_query(SAI_API_ROUTER_INTERFACE,     (void **)&sai_router_intfs_api);
+    sai_api_query(SAI_API_NEIGHBOR,             (void **)&sai_neighbor_api);
+    sai_api_query(SAI_API_NEXT_HOP,             (void **)&sai_next_hop_api);
+    sai_api_query(SAI_API_NEXT_HOP_GROUP,       (void **)&sai_next_hop_group_api);
+    sai_api_query(SAI_API_ROUTE,                (void **)&sai_route_api);
+    sai_api_query(SAI_API_LAG,                  (void **)&sai_lag_api);
+    sai_api_query(SAI_API_POLICER,              (void **)&sai_policer_api);
+    sai_api_query(SAI_API_TUNNEL,               (void **)&sai_tunnel_api);
+
+    if (sai_switch_api->initialize_switch(0, "", "", NULL) != SAI_STATUS_SUCCESS)
+        return false;
+
+    sai_attribute_t attr;
+    attr.id = SAI_SWITCH_ATTR_SRC_MAC_ADDRESS;
+    if (sai_switch_api->get_switch_attribute(1, &attr) != SAI_STATUS_SUCCESS)
+        return false;
+    gMacAddress = attr.value.mac;
+
+    attr.id = SAI_SWITCH_ATTR_DEFAULT_VIRTUAL_ROUTER_ID;
+    if (sai_switch_api->get_switch_attribute(1, &attr) != SAI_STATUS_SUCCESS)
+        return false;
+    gVirtualRouterId = attr.value.oid;
+
+    return true;
+}
+
+static void usage(char **argv)
+{
+    cout << "Usage: " << argv[0] << " [-n counts] [-w neighbors] [-f flaps] [-l latency] [-b batch] [-d db]" << endl;
+    cout << "    -n counts     comma separated route counts, default " << DEFAULT_ROUTE_COUNTS << endl;
+    cout << "    -w neighbors  number of neighbors, at least 3, default " << DEFAULT_NEIGHBOR_COUNT << endl;
+    cout << "    -f flaps      number of flaps per flap scenario, default " << DEFAULT_FLAP_COUNT << endl;
+    cout << "    -l latency    mock SAI latency of every call in microseconds, default 0" << endl;
+    cout << "    -b batch      orch batch size, default " << DEFAULT_BATCH_SIZE << endl;
+    cout << "    -d db         Redis database to use and flush, default " << DEFAULT_BENCH_DB << endl;
+}
+
+int main(int argc, char **argv)
+{
+    swss::Logger::getInstance().setMinPrio(swss::Logger::SWSS_ERROR);
+
+    string counts_str = DEFAULT_ROUTE_COUNTS;
+    int neighbors = DEFAULT_NEIGHBOR_COUNT;
+    int flaps = DEFAULT_FLAP_COUNT;
+    int db = DEFAULT_BENCH_DB;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:f:l:b:d:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            counts_str = optarg;
+            break;
+        case 'w':
+            neighbors = atoi(optarg);
+            break;
+        case 'f':
+            flaps = atoi(optarg);
+            break;
+        case 'l':
+            mockSaiSetLatency(SAI_API_UNSPECIFIED, (uint32_t)atoi(optarg));
+            break;
+        case 'b':
+            gBatchSize = atoi(optarg);
+            break;
+        case 'd':
+            db = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv);
+            exit(EXIT_SUCCESS);
+        default: /* '?' */
+            usage(argv);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    vector<size_t> counts;
+    istringstream iss(counts_str);
+    string count;
+    while (getline(iss, count, ','))
+        counts.push_back(stoul(count));
+
+    if (neighbors < 3 || gBatchSize <= 0 || counts.empty())
+    {
+        usage(argv);
+        exit(EXIT_FAILURE);
+    }
+
+    /* One port per neighbor */
+    mockSaiSetPortCount(neighbors);
+
+    if (!initSai())
+    {
+        cerr << "Failed to initialize the mock SAI" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    OrchBench bench(db, neighbors);
+    bench.setup();
+
+    printHeader();
+
+    for (size_t n : counts)
+    {
+        BenchResult result = bench.addRoutes(n);
+        printResult(result);
+
+        result = bench.flapEcmpMember(n, flaps);
+        printResult(result);
+
+        result = bench.flapNeighbor(n, flaps);
+        printResult(result);
+
+        result = bench.resyncRoutes(n);
+        printResult(result);
+
+        result = bench.withdrawRoutes(n);
+        printResult(result);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,35 +1,77 @@
 #include "orchdaemon.h"
+#include "saitracer.h"
+#include "common/recorder.h"
 
 #include "logger.h"
 
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 using namespace std;
 using namespace swss;
 
-OrchDaemon::OrchDaemon()
+/* Longest wait in milliseconds for an event, bounding the delay of the record flushes and statistics */
+#define SELECT_TIMEOUT 1000
+/* Interval in seconds between two updates of the orch statistics */
+#define STATS_INTERVAL 10
+
+OrchDaemon::OrchDaemon(bool threaded) :
+    m_threaded(threaded)
 {
-    m_applDb = nullptr;
-    m_asicDb = nullptr;
 }
 
 OrchDaemon::~OrchDaemon()
 {
-    if (m_applDb)
-        delete(m_applDb);
-
-    if (m_asicDb)
-        delete(m_asicDb);
-
     for (Orch *o : m_orchList)
         delete(o);
+
+    for (OrchLoop *loop : m_loops)
+    {
+        delete(loop->select);
+
+        if (loop->saiStatsTable)
+            delete(loop->saiStatsTable);
+
+        delete(loop->statsTable);
+        delete(loop->counterDb);
+        delete(loop->applDb);
+        delete(loop);
+    }
+}
+
+OrchLoop *OrchDaemon::addLoop(string name)
+{
+    OrchLoop *loop = new OrchLoop();
+
+    /* Database connections are not shared between threads */
+    loop->name = name;
+    loop->applDb = new DBConnector(APPL_DB, "localhost", 6379, 0);
+    loop->counterDb = new DBConnector(COUNTERS_DB, "localhost", 6379, 0);
+    loop->statsTable = new Table(loop->counterDb, COUNTERS_ORCH_STATS_TABLE);
+    loop->saiStatsTable = nullptr;
+    loop->select = new EpollSelect();
+
+    m_loops.push_back(loop);
+    return loop;
 }
 
 bool OrchDaemon::init()
 {
     SWSS_LOG_ENTER();
 
-    m_applDb = new DBConnector(APPL_DB, "localhost", 6379, 0);
+    /*
+     * PortsOrch, IntfsOrch, NeighOrch and RouteOrch use each other's
+     * state and share a loop. CoppOrch and TunnelDecapOrch depend on no
+     * other orch and get their own loop in threaded mode.
+     */
+    OrchLoop *main_loop = addLoop("main");
+    OrchLoop *copp_loop = m_threaded ? addLoop("copp") : main_loop;
+    OrchLoop *tunnel_loop = m_threaded ? addLoop("tunnel") : main_loop;
+
+    if (isSaiTracerInstalled())
+        main_loop->saiStatsTable = new Table(main_loop->counterDb, COUNTERS_SAI_STATS_TABLE);
 
     vector<string> ports_tables = {
         APP_PORT_TABLE_NAME,
@@ -37,15 +79,33 @@ bool OrchDaemon::init()
         APP_LAG_TABLE_NAME
     };
 
-    PortsOrch *ports_orch = new PortsOrch(m_applDb, ports_tables);
-    IntfsOrch *intfs_orch = new IntfsOrch(m_applDb, APP_INTF_TABLE_NAME, ports_orch);
-    NeighOrch *neigh_orch = new NeighOrch(m_applDb, APP_NEIGH_TABLE_NAME, ports_orch);
-    RouteOrch *route_orch = new RouteOrch(m_applDb, APP_ROUTE_TABLE_NAME, ports_orch, neigh_orch);
-    CoppOrch  *copp_orch  = new CoppOrch(m_applDb, APP_COPP_TABLE_NAME);
-    TunnelDecapOrch *tunnel_decap_orch = new TunnelDecapOrch(m_applDb, APP_TUNNEL_DECAP_TABLE_NAME);
-    
+    DBConnector *appl_db = main_loop->applDb;
+    PortsOrch *ports_orch = new PortsOrch(appl_db, ports_tables);
+    IntfsOrch *intfs_orch = new IntfsOrch(appl_db, APP_INTF_TABLE_NAME, ports_orch);
+    NeighOrch *neigh_orch = new NeighOrch(appl_db, APP_NEIGH_TABLE_NAME, ports_orch);
+    RouteOrch *route_orch = new RouteOrch(appl_db, APP_ROUTE_TABLE_NAME, ports_orch, neigh_orch);
+    CoppOrch  *copp_orch  = new CoppOrch(copp_loop->applDb, APP_COPP_TABLE_NAME);
+    TunnelDecapOrch *tunnel_decap_orch = new TunnelDecapOrch(tunnel_loop->applDb, APP_TUNNEL_DECAP_TABLE_NAME);
+
+    main_loop->orchs = { ports_orch, intfs_orch, neigh_orch, route_orch };
+    copp_loop->orchs.push_back(copp_orch);
+    tunnel_loop->orchs.push_back(tunnel_decap_orch);
+
     m_orchList = { ports_orch, intfs_orch, neigh_orch, route_orch, copp_orch, tunnel_decap_orch };
-    m_select = new Select();
+
+    /* Index every consumer table by its selectable so that dispatching a
+     * wakeup to the owning Orch is a single lookup. */
+    for (OrchLoop *loop : m_loops)
+    {
+        for (Orch *o : loop->orchs)
+        {
+            for (Consumer *c : o->getConsumers())
+            {
+                loop->consumerIndex[c->m_consumer] = make_pair(o, c);
+                loop->select->addSelectable(c->m_consumer);
+            }
+        }
+    }
 
     return true;
 }
@@ -54,50 +114,110 @@ void OrchDaemon::start()
 {
     SWSS_LOG_ENTER();
 
-    for (Orch *o : m_orchList)
+    /*
+     * The SAI calls of the loops are serialized by the SAI redis library.
+     * The orchs of different loops share no object, so the calls of one
+     * loop are committed in order without waiting for the others.
+     */
+    vector<thread> threads;
+    for (size_t i = 1; i < m_loops.size(); i++)
     {
-        m_select->addSelectables(o->getSelectables());
+        threads.push_back(thread([this, i]() {
+            try
+            {
+                run(m_loops[i]);
+            }
+            catch (exception& e)
+            {
+                SWSS_LOG_ERROR("Orch loop %s failed due to exception: %s\n",
+                        m_loops[i]->name.c_str(), e.what());
+                exit(EXIT_FAILURE);
+            }
+        }));
     }
 
-    while (true)
-    {
-        Selectable *s;
-        int fd, ret;
+    run(m_loops[0]);
 
-        ret = m_select->select(&s, &fd, 1);
-        if (ret == Select::ERROR)
-        {
-            SWSS_LOG_NOTICE("Error: %s!\n", strerror(errno));
-            continue;
-        }
+    for (auto &t : threads)
+        t.join();
+}
 
-        if (ret == Select::TIMEOUT)
-        {
-            /* After every TIMEOUT, periodically check all m_toSync map to
-             * execute all the remaining tasks that need to be retried. */
-            for (Orch *o : m_orchList)
-                o->doTask();
+int runOrchLoopStep(EpollSelect &select, ConsumerIndex &consumerIndex, vector<Orch *> &orchs,
+                    int timeout)
+{
+    Selectable *s;
+    int fd, ret;
 
-            continue;
-        }
+    /* Wake up in time for the first retry due */
+    auto due = chrono::steady_clock::time_point::max();
+    for (Orch *o : orchs)
+        due = min(due, o->getRetryDue());
 
-        Orch *o = getOrchByConsumer((ConsumerTable *)s);
-        o->execute(((ConsumerTable *)s)->getTableName());
+    if (due != chrono::steady_clock::time_point::max())
+    {
+        int64_t wait = chrono::duration_cast<chrono::microseconds>(due - chrono::steady_clock::now()).count();
+        timeout = (int)max<int64_t>(0, min<int64_t>(timeout, (wait + 999) / 1000));
+    }
+
+    ret = select.select(&s, &fd, timeout);
+    if (ret == EpollSelect::ERROR)
+    {
+        SWSS_LOG_NOTICE("Error: %s!\n", strerror(errno));
+        return ret;
+    }
+
+    if (ret != EpollSelect::TIMEOUT)
+    {
+        auto it = consumerIndex.find(s);
+        if (it == consumerIndex.end())
+            SWSS_LOG_ERROR("Failed to get Orch class by selectable %p", s);
+        else
+            it->second.first->execute(*it->second.second);
+    }
+
+    /* Retry the left over tasks once due, whether or not events keep arriving */
+    if (chrono::steady_clock::now() >= due)
+    {
+        for (Orch *o : orchs)
+            o->doTask();
     }
+
+    /* Run the tasks of other orchs woken up by the tasks just executed */
+    for (Orch *o : orchs)
+        o->doPendingTask();
+
+    return ret;
 }
 
-Orch *OrchDaemon::getOrchByConsumer(ConsumerTable *c)
+void OrchDaemon::run(OrchLoop *loop)
 {
     SWSS_LOG_ENTER();
 
-    for (Orch *o : m_orchList)
+    SWSS_LOG_NOTICE("Start %s orch loop\n", loop->name.c_str());
+
+    auto last_stats = chrono::steady_clock::now();
+
+    while (true)
     {
-        if (o->hasSelectable(c))
-            return o;
-    }
+        int ret = runOrchLoopStep(*loop->select, loop->consumerIndex, loop->orchs, SELECT_TIMEOUT);
+        if (ret == EpollSelect::ERROR)
+            continue;
+
+        /* Write out the records of the tasks popped before going idle */
+        if (ret == EpollSelect::TIMEOUT)
+            Recorder::getInstance().poll();
+
+        auto now = chrono::steady_clock::now();
+        if (now - last_stats >= chrono::seconds(STATS_INTERVAL))
+        {
+            double interval = chrono::duration<double>(now - last_stats).count();
+            for (Orch *o : loop->orchs)
+                o->publishStats(*loop->statsTable, interval);
 
-    SWSS_LOG_ERROR("Failed to get Orch class by ConsumerTable:%s",
-            c->getTableName().c_str());
+            if (loop->saiStatsTable)
+                publishSaiTracerStats(*loop->saiStatsTable);
 
-    return nullptr;
+            last_stats = now;
+        }
+    }
 }
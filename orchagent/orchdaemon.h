@@ -4,7 +4,8 @@
 #include "dbconnector.h"
 #include "producertable.h"
 #include "consumertable.h"
-#include "select.h"
+#include "common/epollselect.h"
+#include "table.h"
 
 #include "portsorch.h"
 #include "intfsorch.h"
@@ -13,25 +14,58 @@
 #include "copporch.h"
 #include "tunneldecaporch.h"
 
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <chrono>
+
 using namespace swss;
 
+/* COUNTERS_DB table holding the statistics of every consumer table */
+#define COUNTERS_ORCH_STATS_TABLE   "ORCH_STATS"
+
+/* ConsumerIndex: selectable, owning Orch and Consumer */
+typedef unordered_map<Selectable *, pair<Orch *, Consumer *>> ConsumerIndex;
+
+/* OrchLoop: orchs executed by one event loop, with its own database connections */
+struct OrchLoop
+{
+    string              name;           // loop name
+    vector<Orch *>      orchs;          // orchs executed by the loop
+    DBConnector        *applDb;         // APPL_DB connection of the orchs
+    DBConnector        *counterDb;      // COUNTERS_DB connection of the statistics
+    Table              *statsTable;     // orch statistics
+    Table              *saiStatsTable;  // SAI statistics, on the first loop only
+    EpollSelect        *select;         // select over the consumer tables
+    ConsumerIndex       consumerIndex;  // consumer tables by selectable
+};
+
+/*
+ * Run one iteration of an orch loop: execute the consumer selected within
+ * timeout milliseconds, shortened to the first retry due, retry the left
+ * over tasks that are due, then run the tasks woken up meanwhile. Return
+ * the select result.
+ */
+int runOrchLoopStep(EpollSelect &select, ConsumerIndex &consumerIndex, vector<Orch *> &orchs,
+                    int timeout);
+
 class OrchDaemon
 {
 public:
-    OrchDaemon();
+    /* In threaded mode, the independent orchs run their own loop on a thread */
+    OrchDaemon(bool threaded = false);
     ~OrchDaemon();
 
     bool init();
     void start();
 private:
-    DBConnector *m_applDb;
-    DBConnector *m_asicDb;
+    bool m_threaded;
 
     std::vector<Orch *> m_orchList;
+    std::vector<OrchLoop *> m_loops;
 
-    Select *m_select;
-
-    Orch *getOrchByConsumer(ConsumerTable *c);
+    OrchLoop *addLoop(string name);
+    void run(OrchLoop *loop);
 };
 
 #endif /* SWSS_ORCHDAEMON_H */
@@ -1,95 +1,457 @@
 #include "routeorch.h"
+#include "saiaddress.h"
 
 #include "logger.h"
 
 #include "assert.h"
 
+#include <thread>
+
+extern sai_switch_api_t*            sai_switch_api;
 extern sai_next_hop_group_api_t*    sai_next_hop_group_api;
 extern sai_route_api_t*             sai_route_api;
 
 extern sai_object_id_t gVirtualRouterId;
 
+RouteOrch::RouteOrch(DBConnector *db, string tableName,
+                     PortsOrch *portsOrch, NeighOrch *neighOrch) :
+    Orch(db, tableName),
+    m_portsOrch(portsOrch),
+    m_neighOrch(neighOrch),
+    m_nextHopGroupCount(0),
+    m_maxNextHopGroupCount(DEFAULT_NUMBER_OF_ECMP_GROUPS),
+    m_maxNextHopGroupMembers(DEFAULT_ECMP_MEMBERS),
+    m_generation(0),
+    m_resync(false),
+    m_preparePool(min(max(thread::hardware_concurrency(), 1u), ROUTE_PREPARE_MAX_THREADS) - 1)
+{
+    SWSS_LOG_ENTER();
+
+    sai_attribute_t attr;
+    sai_status_t status;
+
+    /* Get the next hop group capacity of the switch */
+    attr.id = SAI_SWITCH_ATTR_NUMBER_OF_ECMP_GROUPS;
+
+    status = sai_switch_api->get_switch_attribute(1, &attr);
+    if (status != SAI_STATUS_SUCCESS || attr.value.s32 <= 0)
+    {
+        SWSS_LOG_WARN("Failed to get number of next hop groups, use default value %d\n",
+                DEFAULT_NUMBER_OF_ECMP_GROUPS);
+    }
+    else
+        m_maxNextHopGroupCount = attr.value.s32;
+
+    attr.id = SAI_SWITCH_ATTR_ECMP_MEMBERS;
+
+    status = sai_switch_api->get_switch_attribute(1, &attr);
+    if (status != SAI_STATUS_SUCCESS || attr.value.u32 == 0)
+    {
+        SWSS_LOG_WARN("Failed to get number of next hop group members, use default value %d\n",
+                DEFAULT_ECMP_MEMBERS);
+    }
+    else
+        m_maxNextHopGroupMembers = attr.value.u32;
+
+    SWSS_LOG_NOTICE("Maximum number of next hop groups: %d, members per group: %u\n",
+            m_maxNextHopGroupCount, m_maxNextHopGroupMembers);
+
+    m_neighOrch->attach(this);
+}
+
 bool RouteOrch::hasNextHopGroup(IpAddresses ipAddresses)
 {
     return m_syncdNextHopGroups.find(ipAddresses) != m_syncdNextHopGroups.end();
 }
 
-void RouteOrch::doTask(Consumer& consumer)
+void RouteOrch::update(SubjectType type, void *cntx)
 {
     SWSS_LOG_ENTER();
 
-    if (!m_portsOrch->isInitDone())
+    if (type != SUBJECT_TYPE_NEXTHOP_CHANGE)
         return;
 
-    auto it = consumer.m_toSync.begin();
-    while (it != consumer.m_toSync.end())
+    NextHopUpdate *update = static_cast<NextHopUpdate *>(cntx);
+    if (!update->add)
     {
-        KeyOpFieldsValuesTuple t = it->second;
+        invalidateNextHop(update->ip_address);
+        return;
+    }
 
-        string key = kfvKey(t);
-        string op = kfvOp(t);
+    validateNextHop(update->ip_address);
 
-        /* Get notification from application */
-        /* resync application:
-         * When routeorch receives 'resync' message, it marks all current
-         * routes as dirty and waits for 'resync complete' message. For all
-         * newly received routes, if they match current dirty routes, it unmarks
-         * them dirty. After receiving 'resync complete' message, it creates all
-         * newly added routes and removes all dirty routes.
-         */
-        if (key == "resync")
-        {
-            if (op == "SET")
-            {
-                /* Mark all current routes as dirty (DEL) in consumer.m_toSync map */
-                SWSS_LOG_NOTICE("Start resync routes\n");
-                for (auto i : m_syncdRoutes)
-                {
-                    vector<FieldValueTuple> v;
-                    auto x = KeyOpFieldsValuesTuple(i.first.to_string(), DEL_COMMAND, v);
-                    consumer.m_toSync[i.first.to_string()] = x;
-                }
-                m_resync = true;
-            }
-            else
+    auto it_waiters = m_nextHopWaiters.find(update->ip_address);
+    if (it_waiters == m_nextHopWaiters.end())
+        return;
+
+    /*
+     * Move the routes waiting for the new next hop back into m_toSync. They
+     * are executed right after the current task, without waiting for the
+     * retry interval. A route with a newer pending task is simply unblocked.
+     */
+    set<string> waiters;
+    waiters.swap(it_waiters->second);
+    m_nextHopWaiters.erase(it_waiters);
+
+    Consumer &consumer = m_consumerMap.begin()->second;
+    for (auto &key : waiters)
+    {
+        auto it_blocked = m_blockedRoutes.find(key);
+        if (it_blocked == m_blockedRoutes.end())
+            continue;
+
+        if (consumer.m_toSync.find(key) == consumer.m_toSync.end() &&
+            consumer.m_toRetry.find(key) == consumer.m_toRetry.end())
+        {
+            consumer.m_toSync[key] = it_blocked->second.task;
+        }
+
+        unblockRoute(it_blocked);
+    }
+
+    SWSS_LOG_INFO("Wake up %zu routes waiting for next hop %s",
+            waiters.size(), update->ip_address.to_string().c_str());
+}
+
+void RouteOrch::validateNextHop(IpAddress ipAddress)
+{
+    SWSS_LOG_ENTER();
+
+    /*
+     * Add the next hop back to every group expecting it. The number of
+     * groups is bounded by the ASIC capacity, and the routes using them
+     * are fixed with a single member operation per group.
+     */
+    for (auto &it : m_syncdNextHopGroups)
+    {
+        if (it.first.contains(ipAddress) &&
+            it.second.members.find(ipAddress) == it.second.members.end())
+        {
+            addNextHopGroupMember(it.second, ipAddress);
+        }
+    }
+}
+
+void RouteOrch::invalidateNextHop(IpAddress ipAddress)
+{
+    SWSS_LOG_ENTER();
+
+    /* Shrink every group still having other members, in place */
+    for (auto &it : m_syncdNextHopGroups)
+    {
+        if (it.second.members.size() > 1 &&
+            it.second.members.find(ipAddress) != it.second.members.end())
+        {
+            removeNextHopGroupMember(it.second, ipAddress);
+        }
+    }
+
+    Consumer &consumer = m_consumerMap.begin()->second;
+    size_t count = 0;
+
+    /*
+     * The remaining routes still using the next hop point to it directly
+     * or to a group with no other member. Remove them from hardware and
+     * park their next hops until the next hop comes back. Only the routes
+     * of the next hop sets containing it are visited, through the next hop
+     * index of m_nextHopSets.
+     */
+    for (NextHopSetId id : m_nextHopSets.getIds(ipAddress))
+    {
+        IpAddresses next_hops = m_nextHopSets.get(id);
+
+        if (next_hops.getSize() > 1 && hasNextHopGroup(next_hops))
+        {
+            auto &members = m_syncdNextHopGroups[next_hops].members;
+            if (members.find(ipAddress) == members.end())
+                continue;
+        }
+
+        for (auto &route_key : m_nextHopSetRoutes[id])
+        {
+            IpPrefix prefix = route_key.getIpPrefix();
+            string key = prefix.to_string();
+            if (consumer.m_toSync.find(key) == consumer.m_toSync.end() &&
+                consumer.m_toRetry.find(key) == consumer.m_toRetry.end() &&
+                m_blockedRoutes.find(key) == m_blockedRoutes.end())
             {
-                SWSS_LOG_NOTICE("Complete resync routes\n");
-                m_resync = false;
+                /* The parked task keeps the generation the route was last announced in */
+                vector<FieldValueTuple> fvs = { FieldValueTuple("nexthop", next_hops.to_string()) };
+                ParkedRoute &parked = m_blockedRoutes[key];
+                parked.task = KeyOpFieldsValuesTuple(key, SET_COMMAND, fvs);
+                parked.generation = m_syncdRoutes.find(route_key)->generation;
+                m_nextHopWaiters[ipAddress].insert(key);
             }
 
-            it = consumer.m_toSync.erase(it);
-            continue;
+            removeRoute("", prefix);
+            count++;
         }
+    }
+
+    SWSS_LOG_NOTICE("Remove %zu routes using next hop %s",
+            count, ipAddress.to_string().c_str());
+
+    flushRoutes(consumer);
+}
+
+bool RouteOrch::blockRoute(KeyOpFieldsValuesTuple &t, IpAddresses nextHops)
+{
+    string key = kfvKey(t);
+    bool blocked = false;
 
-        if (m_resync)
+    /* Register the route as a waiter of every next hop it is missing */
+    for (auto it : nextHops.getIpAddresses())
+    {
+        if (!m_neighOrch->hasNextHop(it))
         {
-            it++;
+            m_nextHopWaiters[it].insert(key);
+            blocked = true;
+        }
+    }
+
+    if (blocked)
+        m_blockedRoutes[key] = { t, m_generation };
+
+    return blocked;
+}
+
+void RouteOrch::unblockRoute(ParkedRouteTable::iterator it)
+{
+    /* Remove the route from the waiters of every next hop of its task */
+    for (auto &fv : kfvFieldsValues(it->second.task))
+    {
+        if (fvField(fv) != "nexthop")
             continue;
+
+        for (auto ip : IpAddresses(fvValue(fv)).getIpAddresses())
+        {
+            auto it_waiters = m_nextHopWaiters.find(ip);
+            if (it_waiters == m_nextHopWaiters.end())
+                continue;
+
+            it_waiters->second.erase(it->first);
+            if (it_waiters->second.empty())
+                m_nextHopWaiters.erase(it_waiters);
         }
+    }
 
-        IpPrefix ip_prefix = IpPrefix(key);
+    m_blockedRoutes.erase(it);
+}
 
-        /* Currently we don't support IPv6 */
-        if (!ip_prefix.isV4())
+bool RouteOrch::degradeRoute(KeyOpFieldsValuesTuple &t, IpPrefix ipPrefix, IpAddresses nextHops)
+{
+    /* Only a route needing a new group while none is left is degraded */
+    if (nextHops.getSize() <= 1 || hasNextHopGroup(nextHops) ||
+        m_nextHopGroupCount < m_maxNextHopGroupCount)
+    {
+        return false;
+    }
+
+    /* Without a temporary route carrying its traffic the route is blocked */
+    if (!addTempRoute(ipPrefix, nextHops))
+        return false;
+
+    m_degradedRoutes[kfvKey(t)] = { t, m_generation };
+    return true;
+}
+
+void RouteOrch::doPendingTask()
+{
+    promoteRoutes();
+
+    Orch::doPendingTask();
+}
+
+void RouteOrch::promoteRoutes()
+{
+    SWSS_LOG_ENTER();
+
+    int free_groups = m_maxNextHopGroupCount - m_nextHopGroupCount;
+    if (free_groups <= 0 || m_degradedRoutes.empty())
+        return;
+
+    /*
+     * Next hop groups have been freed, give them to the degraded routes.
+     * The routes sharing next hops need a single group, so only as many
+     * distinct next hop sets as free groups are promoted. The promoted
+     * routes are executed right away by Orch::doPendingTask(), taking the
+     * groups back before the retry sweep.
+     */
+    Consumer &consumer = m_consumerMap.begin()->second;
+    set<string> claimed;
+    size_t count = 0;
+
+    auto it = m_degradedRoutes.begin();
+    while (it != m_degradedRoutes.end())
+    {
+        const string &key = it->first;
+
+        /* A route with a newer pending task does not need the group */
+        if (consumer.m_toSync.find(key) != consumer.m_toSync.end() ||
+            consumer.m_toRetry.find(key) != consumer.m_toRetry.end())
         {
-            SWSS_LOG_WARN("Get unsupported IPv6 task ip:%s", ip_prefix.to_string().c_str());
-            it = consumer.m_toSync.erase(it);
+            it = m_degradedRoutes.erase(it);
             continue;
         }
 
-        if (op == SET_COMMAND)
+        string next_hops;
+        for (auto &fv : kfvFieldsValues(it->second.task))
         {
-            IpAddresses ip_addresses;
-            string alias;
+            if (fvField(fv) == "nexthop")
+                next_hops = fvValue(fv);
+        }
+
+        if (claimed.find(next_hops) == claimed.end())
+        {
+            if ((int)claimed.size() >= free_groups)
+            {
+                it++;
+                continue;
+            }
+            claimed.insert(next_hops);
+        }
+
+        consumer.m_toSync[key] = it->second.task;
+        it = m_degradedRoutes.erase(it);
+        count++;
+    }
 
+    SWSS_LOG_INFO("Promote %zu routes to %zu free next hop groups", count, claimed.size());
+}
+
+void RouteOrch::prepareRoute(const KeyOpFieldsValuesTuple &t, RoutePrepared &p)
+{
+    p.valid = false;
+    p.duplicate = false;
+    p.route = nullptr;
+
+    try
+    {
+        p.ip_prefix = IpPrefix(kfvKey(t));
+
+        if (kfvOp(t) == SET_COMMAND)
+        {
             for (auto i : kfvFieldsValues(t))
             {
                 if (fvField(i) == "nexthop")
-                    ip_addresses = IpAddresses(fvValue(i));
+                    p.next_hops = IpAddresses(fvValue(i));
 
                 if (fvField(i) == "ifindex")
-                    alias = fvValue(i);
+                    p.alias = fvValue(i);
             }
+        }
+    }
+    catch (exception &e)
+    {
+        return;
+    }
+
+    p.valid = true;
+    p.route_key = RouteKey(p.ip_prefix);
+    p.route = m_syncdRoutes.find(p.route_key);
+    p.duplicate = p.route != nullptr && m_nextHopSets.get(p.route->next_hops) == p.next_hops;
+}
+
+void RouteOrch::prepareRoutes(Consumer &consumer, vector<RoutePrepared> &prepared)
+{
+    SWSS_LOG_ENTER();
+
+    vector<const KeyOpFieldsValuesTuple *> tasks;
+    tasks.reserve(consumer.m_toSync.size());
+    for (auto &it : consumer.m_toSync)
+        tasks.push_back(&it.second);
+
+    prepared.resize(tasks.size());
+
+    size_t shards = min(m_preparePool.size(), tasks.size() / ROUTE_PREPARE_SHARD_SIZE);
+    if (shards <= 1)
+    {
+        for (size_t i = 0; i < tasks.size(); i++)
+            prepareRoute(*tasks[i], prepared[i]);
+        return;
+    }
+
+    /*
+     * Split the tasks into contiguous shards prepared in parallel by the
+     * pool. The shards only read m_syncdRoutes, which is not changed before
+     * the pool returns, and each writes its own slots of prepared.
+     */
+    m_preparePool.run(shards, [this, &tasks, &prepared, shards](size_t shard) {
+        size_t end = (shard + 1) * tasks.size() / shards;
+        for (size_t i = shard * tasks.size() / shards; i < end; i++)
+            prepareRoute(*tasks[i], prepared[i]);
+    });
+
+    SWSS_LOG_INFO("Prepare %zu route tasks in %zu shards", tasks.size(), shards);
+}
+
+void RouteOrch::doTask(Consumer& consumer)
+{
+    SWSS_LOG_ENTER();
+
+    if (!m_portsOrch->isInitDone())
+        return;
+
+    /*
+     * resync application:
+     * When routeorch receives 'resync' message, it starts a new route
+     * generation. Every route announced afterwards is marked with it. After
+     * receiving 'resync complete' message, it removes all the routes left
+     * in an older generation. The message is handled before the routes of
+     * the same pass, and the completion after them.
+     */
+    bool resync_done = false;
+    auto it_resync = consumer.m_toSync.find("resync");
+    if (it_resync != consumer.m_toSync.end())
+    {
+        if (kfvOp(it_resync->second) == SET_COMMAND)
+        {
+            SWSS_LOG_NOTICE("Start resync routes\n");
+            m_generation++;
+            m_resync = true;
+        }
+        else
+        {
+            SWSS_LOG_NOTICE("Complete resync routes\n");
+            resync_done = m_resync;
+            m_resync = false;
+        }
+
+        consumer.m_toSync.erase(it_resync);
+    }
+
+    /* Parse and diff the tasks ahead of the SAI programming */
+    vector<RoutePrepared> prepared;
+    prepareRoutes(consumer, prepared);
+
+    size_t index = 0;
+    auto it = consumer.m_toSync.begin();
+    while (it != consumer.m_toSync.end())
+    {
+        KeyOpFieldsValuesTuple t = it->second;
+        RoutePrepared &p = prepared[index++];
+
+        string key = kfvKey(t);
+        string op = kfvOp(t);
+
+        /* A newer task supersedes the blocked or degraded one */
+        auto it_blocked = m_blockedRoutes.find(key);
+        if (it_blocked != m_blockedRoutes.end())
+            unblockRoute(it_blocked);
+        m_degradedRoutes.erase(key);
+
+        if (!p.valid)
+        {
+            SWSS_LOG_ERROR("Failed to parse route task %s\n", key.c_str());
+            it = consumer.m_toSync.erase(it);
+            continue;
+        }
+
+        IpPrefix &ip_prefix = p.ip_prefix;
+
+        if (op == SET_COMMAND)
+        {
+            IpAddresses &ip_addresses = p.next_hops;
 
             // TODO: set to blackhold if nexthop is empty?
             if (ip_addresses.getSize() == 0)
@@ -100,15 +462,29 @@ void RouteOrch::doTask(Consumer& consumer)
 
             // TODO: cannot trust m_portsOrch->getPortIdByAlias because sometimes alias is empty
             // TODO: need to split aliases with ',' and verify the next hops?
-            if (alias == "eth0" || alias == "lo" || alias == "docker0")
+            if (p.alias == "eth0" || p.alias == "lo" || p.alias == "docker0")
             {
                 it = consumer.m_toSync.erase(it);
                 continue;
             }
 
-            if (m_syncdRoutes.find(ip_prefix) == m_syncdRoutes.end() || m_syncdRoutes[ip_prefix] != ip_addresses)
+            /* Mark the route as announced in the current generation */
+            if (p.route != nullptr)
+                p.route->generation = m_generation;
+
+            if (!p.duplicate)
             {
-                if (addRoute(ip_prefix, ip_addresses))
+                /* The route is the only user of its group, change the members */
+                if (updateNextHopGroup(ip_prefix, ip_addresses))
+                    it = consumer.m_toSync.erase(it);
+                /* The task is erased once the bulker reports success */
+                else if (addRoute(key, ip_prefix, ip_addresses))
+                    it++;
+                /* Wait for a next hop group to be freed instead of the retry sweep */
+                else if (degradeRoute(t, ip_prefix, ip_addresses))
+                    it = consumer.m_toSync.erase(it);
+                /* Wait for the missing next hops instead of the retry sweep */
+                else if (blockRoute(t, ip_addresses))
                     it = consumer.m_toSync.erase(it);
                 else
                     it++;
@@ -119,12 +495,10 @@ void RouteOrch::doTask(Consumer& consumer)
         }
         else if (op == DEL_COMMAND)
         {
-            if (m_syncdRoutes.find(ip_prefix) != m_syncdRoutes.end())
+            if (p.route != nullptr)
             {
-                if (removeRoute(ip_prefix))
-                    it = consumer.m_toSync.erase(it);
-                else
-                    it++;
+                removeRoute(key, ip_prefix);
+                it++;
             }
             else
                 /* Cannot locate the route */
@@ -136,6 +510,152 @@ void RouteOrch::doTask(Consumer& consumer)
             it = consumer.m_toSync.erase(it);
         }
     }
+
+    if (resync_done)
+        removeStaleRoutes(consumer);
+
+    flushRoutes(consumer);
+}
+
+bool RouteOrch::isParked(Consumer &consumer, const string &key)
+{
+    return m_blockedRoutes.find(key) != m_blockedRoutes.end() ||
+           m_degradedRoutes.find(key) != m_degradedRoutes.end();
+}
+
+void RouteOrch::removeStaleRoutes(Consumer &consumer)
+{
+    SWSS_LOG_ENTER();
+
+    size_t count = 0;
+
+    /*
+     * Remove the routes not announced since the resync started. A route
+     * with a task pending in this pass has its own operation queued. A
+     * route failing to be removed keeps its generation and is removed by
+     * the next resync.
+     */
+    for (uint8_t family : { AF_INET, AF_INET6 })
+    {
+        for (auto &it : m_syncdRoutes.getRoutes(family))
+        {
+            if (it.second.generation == m_generation)
+                continue;
+
+            IpPrefix prefix = it.first.getIpPrefix();
+            if (consumer.m_toSync.find(prefix.to_string()) != consumer.m_toSync.end())
+                continue;
+
+            removeRoute("", prefix);
+            count++;
+        }
+    }
+
+    /*
+     * The blocked and degraded routes not announced since the resync
+     * started are stale too. Forget them so that they are not installed
+     * when their next hops or a next hop group come back.
+     */
+    auto it_blocked = m_blockedRoutes.begin();
+    while (it_blocked != m_blockedRoutes.end())
+    {
+        auto it_next = next(it_blocked);
+        if (it_blocked->second.generation != m_generation)
+        {
+            unblockRoute(it_blocked);
+            count++;
+        }
+        it_blocked = it_next;
+    }
+
+    auto it_degraded = m_degradedRoutes.begin();
+    while (it_degraded != m_degradedRoutes.end())
+    {
+        if (it_degraded->second.generation != m_generation)
+        {
+            it_degraded = m_degradedRoutes.erase(it_degraded);
+            count++;
+        }
+        else
+            it_degraded++;
+    }
+
+    SWSS_LOG_NOTICE("Remove %zu stale routes\n", count);
+}
+
+void RouteOrch::flushRoutes(Consumer &consumer)
+{
+    SWSS_LOG_ENTER();
+
+    if (m_bulkContexts.empty())
+        return;
+
+    /* Program all the queued routes and collect their status */
+    m_routeBulker.flush();
+
+    for (auto &ctx : m_bulkContexts)
+    {
+        bool success = ctx.next_hops.getSize() ? addRoutePost(ctx) : removeRoutePost(ctx);
+
+        if (success && !ctx.key.empty())
+            consumer.m_toSync.erase(ctx.key);
+    }
+
+    /*
+     * Remove the next hop groups no longer referenced. This is done after
+     * all the queued routes are processed since several routes may share
+     * a newly created next hop group.
+     */
+    for (auto &ctx : m_bulkContexts)
+    {
+        for (auto next_hops : { ctx.next_hops, ctx.old_next_hops })
+        {
+            if (next_hops.getSize() > 1 && hasNextHopGroup(next_hops)
+                && m_syncdNextHopGroups[next_hops].ref_count == 0)
+            {
+                removeNextHopGroup(next_hops);
+            }
+        }
+    }
+
+    m_bulkContexts.clear();
+}
+
+void RouteOrch::addNextHopRoute(const RouteKey &routeKey, RouteEntry &route)
+{
+    if (m_nextHopSetRoutes.size() <= route.next_hops)
+        m_nextHopSetRoutes.resize(route.next_hops + 1);
+
+    vector<RouteKey> &routes = m_nextHopSetRoutes[route.next_hops];
+    route.set_index = (uint32_t)routes.size();
+    routes.push_back(routeKey);
+}
+
+void RouteOrch::removeNextHopRoute(RouteEntry &route)
+{
+    vector<RouteKey> &routes = m_nextHopSetRoutes[route.next_hops];
+
+    /* Move the last route of the set into the freed slot */
+    if (route.set_index != routes.size() - 1)
+    {
+        routes[route.set_index] = routes.back();
+        m_syncdRoutes.find(routes.back())->set_index = route.set_index;
+    }
+    routes.pop_back();
+
+    /* Free the list of a set no longer used */
+    if (routes.empty())
+        vector<RouteKey>().swap(routes);
+}
+
+size_t RouteOrch::countNextHopRoutes(IpAddress ipAddress)
+{
+    size_t count = 0;
+
+    for (NextHopSetId id : m_nextHopSets.getIds(ipAddress))
+        count += m_nextHopSetRoutes[id].size();
+
+    return count;
 }
 
 void RouteOrch::increaseNextHopRefCount(IpAddresses ipAddresses)
@@ -170,30 +690,37 @@ bool RouteOrch::addNextHopGroup(IpAddresses ipAddresses)
 
     assert(!hasNextHopGroup(ipAddresses));
 
-    if (m_nextHopGroupCount > NHGRP_MAX_SIZE)
+    if (m_nextHopGroupCount >= m_maxNextHopGroupCount)
     {
         SWSS_LOG_DEBUG("Failed to create next hop group. Exceeding maximum number of next hop groups.\n");
         return false;
     }
 
     vector<sai_object_id_t> next_hop_ids;
-    set<IpAddress> next_hop_set = ipAddresses.getIpAddresses();
+    set<IpAddress> next_hop_set;
 
-    /* Assert each IP address exists in m_syncdNextHops table,
-     * and add the corresponding next_hop_id to next_hop_ids. */
-    for (auto it : next_hop_set)
+    /* Create the group with the next hops existing in m_syncdNextHops table.
+     * The missing ones are added to the group once they are resolved. */
+    for (auto it : ipAddresses.getIpAddresses())
     {
         if (!m_neighOrch->hasNextHop(it))
         {
             SWSS_LOG_NOTICE("Failed to get next hop entry ip:%s",
                     it.to_string().c_str());
-            return false;
+            continue;
         }
 
-        sai_object_id_t next_hop_id = m_neighOrch->getNextHopId(it);
-        next_hop_ids.push_back(next_hop_id);
+        /* The remaining next hops are added once members are freed */
+        if (next_hop_set.size() >= m_maxNextHopGroupMembers)
+            break;
+
+        next_hop_set.insert(it);
+        next_hop_ids.push_back(m_neighOrch->getNextHopId(it));
     }
 
+    if (next_hop_set.empty())
+        return false;
+
     sai_attribute_t nhg_attr;
     vector<sai_attribute_t> nhg_attrs;
 
@@ -217,8 +744,9 @@ bool RouteOrch::addNextHopGroup(IpAddresses ipAddresses)
     }
 
     m_nextHopGroupCount ++;
-    SWSS_LOG_NOTICE("Create next hop group nhgid:%llx nh:%s \n",
-                    next_hop_group_id, ipAddresses.to_string().c_str());
+    SWSS_LOG_NOTICE("Create next hop group nhgid:%llx nh:%s (%d/%d)\n",
+                    next_hop_group_id, ipAddresses.to_string().c_str(),
+                    m_nextHopGroupCount, m_maxNextHopGroupCount);
 
     /* Increate the ref_count for the next hops used by the next hop group. */
     for (auto it : next_hop_set)
@@ -231,6 +759,7 @@ bool RouteOrch::addNextHopGroup(IpAddresses ipAddresses)
     NextHopGroupEntry next_hop_group_entry;
     next_hop_group_entry.next_hop_group_id = next_hop_group_id;
     next_hop_group_entry.ref_count = 0;
+    next_hop_group_entry.members = next_hop_set;
     m_syncdNextHopGroups[ipAddresses] = next_hop_group_entry;
 
     return true;
@@ -254,8 +783,7 @@ bool RouteOrch::removeNextHopGroup(IpAddresses ipAddresses)
 
         m_nextHopGroupCount --;
 
-        set<IpAddress> ip_address_set = ipAddresses.getIpAddresses();
-        for (auto it : ip_address_set)
+        for (auto it : m_syncdNextHopGroups[ipAddresses].members)
             m_neighOrch->decreaseNextHopRefCount(it);
 
         m_syncdNextHopGroups.erase(ipAddresses);
@@ -264,10 +792,169 @@ bool RouteOrch::removeNextHopGroup(IpAddresses ipAddresses)
     return true;
 }
 
-void RouteOrch::addTempRoute(IpPrefix ipPrefix, IpAddresses nextHops)
+bool RouteOrch::addNextHopGroupMember(NextHopGroupEntry &entry, IpAddress ipAddress)
+{
+    SWSS_LOG_ENTER();
+
+    if (entry.members.size() >= m_maxNextHopGroupMembers)
+    {
+        SWSS_LOG_DEBUG("Failed to add next hop %s to next hop group nhgid:%llx. Exceeding maximum number of members.\n",
+                ipAddress.to_string().c_str(), entry.next_hop_group_id);
+        return false;
+    }
+
+    sai_object_id_t next_hop_id = m_neighOrch->getNextHopId(ipAddress);
+    sai_status_t status = sai_next_hop_group_api->
+            add_next_hop_to_group(entry.next_hop_group_id, 1, &next_hop_id);
+    if (status != SAI_STATUS_SUCCESS)
+    {
+        SWSS_LOG_ERROR("Failed to add next hop %s to next hop group nhgid:%llx\n",
+                ipAddress.to_string().c_str(), entry.next_hop_group_id);
+        return false;
+    }
+
+    entry.members.insert(ipAddress);
+    m_neighOrch->increaseNextHopRefCount(ipAddress);
+
+    SWSS_LOG_INFO("Add next hop %s to next hop group nhgid:%llx",
+            ipAddress.to_string().c_str(), entry.next_hop_group_id);
+    return true;
+}
+
+bool RouteOrch::removeNextHopGroupMember(NextHopGroupEntry &entry, IpAddress ipAddress)
+{
+    SWSS_LOG_ENTER();
+
+    sai_object_id_t next_hop_id = m_neighOrch->getNextHopId(ipAddress);
+    sai_status_t status = sai_next_hop_group_api->
+            remove_next_hop_from_group(entry.next_hop_group_id, 1, &next_hop_id);
+    if (status != SAI_STATUS_SUCCESS)
+    {
+        SWSS_LOG_ERROR("Failed to remove next hop %s from next hop group nhgid:%llx\n",
+                ipAddress.to_string().c_str(), entry.next_hop_group_id);
+        return false;
+    }
+
+    entry.members.erase(ipAddress);
+    m_neighOrch->decreaseNextHopRefCount(ipAddress);
+
+    SWSS_LOG_INFO("Remove next hop %s from next hop group nhgid:%llx",
+            ipAddress.to_string().c_str(), entry.next_hop_group_id);
+    return true;
+}
+
+bool RouteOrch::updateNextHopGroup(IpPrefix ipPrefix, IpAddresses nextHops)
+{
+    SWSS_LOG_ENTER();
+
+    RouteKey route_key(ipPrefix);
+    RouteEntry *route = m_syncdRoutes.find(route_key);
+    if (route == nullptr)
+        return false;
+
+    IpAddresses old_next_hops = m_nextHopSets.get(route->next_hops);
+
+    /*
+     * Only a group used by this route alone can be changed in place, and
+     * only when no group exists yet for the new next hops.
+     */
+    if (old_next_hops.getSize() <= 1 || nextHops.getSize() <= 1 ||
+        hasNextHopGroup(nextHops) ||
+        m_syncdNextHopGroups[old_next_hops].ref_count != 1)
+    {
+        return false;
+    }
+
+    set<IpAddress> next_hop_set = nextHops.getIpAddresses();
+    bool resolved = false;
+    for (auto it : next_hop_set)
+    {
+        if (m_neighOrch->hasNextHop(it))
+            resolved = true;
+    }
+
+    /* Keep at least one member in the group at all times */
+    if (!resolved)
+        return false;
+
+    NextHopGroupEntry &entry = m_syncdNextHopGroups[old_next_hops];
+    vector<IpAddress> added, removed;
+    bool success = true;
+
+    /* Add the new members first so that the group never becomes empty */
+    for (auto it : next_hop_set)
+    {
+        if (entry.members.find(it) != entry.members.end() ||
+            !m_neighOrch->hasNextHop(it))
+        {
+            continue;
+        }
+
+        if (!addNextHopGroupMember(entry, it))
+        {
+            success = false;
+            break;
+        }
+        added.push_back(it);
+    }
+
+    /* Remove the old members only once all the new ones are in */
+    if (success)
+    {
+        set<IpAddress> members = entry.members;
+        for (auto it : members)
+        {
+            if (next_hop_set.find(it) != next_hop_set.end())
+                continue;
+
+            if (!removeNextHopGroupMember(entry, it))
+            {
+                success = false;
+                break;
+            }
+            removed.push_back(it);
+        }
+    }
+
+    /*
+     * Put the members back so that the group still matches its key, the
+     * caller then creates a new group for the next hops instead.
+     */
+    if (!success)
+    {
+        for (auto it : removed)
+            addNextHopGroupMember(entry, it);
+        for (auto it : added)
+            removeNextHopGroupMember(entry, it);
+
+        SWSS_LOG_INFO("Failed to update next hop group nhgid:%llx of route %s in place",
+                entry.next_hop_group_id, ipPrefix.to_string().c_str());
+        return false;
+    }
+
+    /* The members now match the new next hops, rekey the group */
+    NextHopGroupEntry updated = entry;
+    m_syncdNextHopGroups.erase(old_next_hops);
+    m_syncdNextHopGroups[nextHops] = updated;
+
+    removeNextHopRoute(*route);
+    m_nextHopSets.release(route->next_hops);
+    route->next_hops = m_nextHopSets.acquire(nextHops);
+    addNextHopRoute(route_key, *route);
+
+    SWSS_LOG_INFO("Update next hop group nhgid:%llx of route %s in place with next hops %s",
+            updated.next_hop_group_id, ipPrefix.to_string().c_str(), nextHops.to_string().c_str());
+    return true;
+}
+
+/*
+ * Return true when the route carries traffic on a subset of its next hops,
+ * either through the temporary route queued here or the one already synced.
+ */
+bool RouteOrch::addTempRoute(IpPrefix ipPrefix, IpAddresses nextHops)
 {
     bool to_add = false;
-    auto it_route = m_syncdRoutes.find(ipPrefix);
+    RouteEntry *route = m_syncdRoutes.find(RouteKey(ipPrefix));
     auto next_hop_set = nextHops.getIpAddresses();
 
     /*
@@ -275,9 +962,9 @@ void RouteOrch::addTempRoute(IpPrefix ipPrefix, IpAddresses nextHops)
      * or it is in m_syncdRoutes but the original next hop(s) is not a
      * subset of the next hop group to be added.
      */
-    if (it_route != m_syncdRoutes.end())
+    if (route != nullptr)
     {
-        auto tmp_set = m_syncdRoutes[ipPrefix].getIpAddresses();
+        auto tmp_set = m_nextHopSets.get(route->next_hops).getIpAddresses();
         for (auto it : tmp_set)
         {
             if (next_hop_set.find(it) == next_hop_set.end())
@@ -287,42 +974,84 @@ void RouteOrch::addTempRoute(IpPrefix ipPrefix, IpAddresses nextHops)
     else
         to_add = true;
 
-    if (to_add)
+    if (!to_add)
+        return true;
+
+    /* Remove next hops that are not in m_syncdNextHops */
+    for (auto it = next_hop_set.begin(); it != next_hop_set.end();)
     {
-        /* Remove next hops that are not in m_syncdNextHops */
-        for (auto it = next_hop_set.begin(); it != next_hop_set.end();)
+        if (!m_neighOrch->hasNextHop(*it))
         {
-            if (!m_neighOrch->hasNextHop(*it))
+            SWSS_LOG_NOTICE("Failed to get next hop entry ip:%s",
+                   (*it).to_string().c_str());
+            it = next_hop_set.erase(it);
+        }
+        else
+            it++;
+    }
+
+    /* Return if next_hop_set is empty */
+    if (next_hop_set.empty())
+        return false;
+
+    /*
+     * Reuse the existing group with the most next hops out of the set,
+     * otherwise fall back to the next hop carrying the fewest routes.
+     */
+    IpAddresses tmp_next_hop;
+    size_t tmp_size = 0;
+    for (auto &it : m_syncdNextHopGroups)
+    {
+        auto group_set = it.first.getIpAddresses();
+        if (group_set.size() <= tmp_size)
+            continue;
+
+        bool subset = true;
+        for (auto ip : group_set)
+        {
+            if (next_hop_set.find(ip) == next_hop_set.end())
             {
-                SWSS_LOG_NOTICE("Failed to get next hop entry ip:%s",
-                       (*it).to_string().c_str());
-                it = next_hop_set.erase(it);
+                subset = false;
+                break;
             }
-            else
-                it++;
         }
 
-        /* Return if next_hop_set is empty */
-        if (next_hop_set.empty())
-            return;
-
-        /* Randomly pick an address from the set */
-        auto it = next_hop_set.begin();
-        advance(it, rand() % next_hop_set.size());
+        if (subset)
+        {
+            tmp_next_hop = it.first;
+            tmp_size = group_set.size();
+        }
+    }
 
-        /* Set the route's temporary next hop to be the randomly picked one */
-        IpAddresses tmp_next_hop((*it).to_string());
-        addRoute(ipPrefix, tmp_next_hop);
+    if (tmp_size == 0)
+    {
+        size_t min_routes = 0;
+        for (auto ip : next_hop_set)
+        {
+            size_t routes = countNextHopRoutes(ip);
+            if (tmp_size == 0 || routes < min_routes)
+            {
+                tmp_next_hop = IpAddresses(ip.to_string());
+                tmp_size = 1;
+                min_routes = routes;
+            }
+        }
     }
+
+    /* Set the route's temporary next hop(s) to the picked ones */
+    SWSS_LOG_NOTICE("Add temporary route %s with next hop(s) %s instead of %s",
+            ipPrefix.to_string().c_str(), tmp_next_hop.to_string().c_str(),
+            nextHops.to_string().c_str());
+    return addRoute("", ipPrefix, tmp_next_hop);
 }
 
-bool RouteOrch::addRoute(IpPrefix ipPrefix, IpAddresses nextHops)
+bool RouteOrch::addRoute(string key, IpPrefix ipPrefix, IpAddresses nextHops)
 {
     SWSS_LOG_ENTER();
 
     /* next_hop_id indicates the next hop id or next hop group id of this route */
     sai_object_id_t next_hop_id;
-    auto it_route = m_syncdRoutes.find(ipPrefix);
+    RouteEntry *route = m_syncdRoutes.find(RouteKey(ipPrefix));
 
     /* The route is pointing to a next hop */
     if (nextHops.getSize() == 1)
@@ -346,8 +1075,12 @@ bool RouteOrch::addRoute(IpPrefix ipPrefix, IpAddresses nextHops)
         {
             if (!addNextHopGroup(nextHops))
             {
-                /* Add a temporary route when a next hop group cannot be added */
-                addTempRoute(ipPrefix, nextHops);
+                /*
+                 * Add a temporary route when a next hop group cannot be added.
+                 * With no group left, degradeRoute() adds it and parks the route.
+                 */
+                if (m_nextHopGroupCount < m_maxNextHopGroupCount)
+                    addTempRoute(ipPrefix, nextHops);
                 /* Return false since the original route is not successfully added */
                 return false;
             }
@@ -356,12 +1089,18 @@ bool RouteOrch::addRoute(IpPrefix ipPrefix, IpAddresses nextHops)
         next_hop_id = m_syncdNextHopGroups[nextHops].next_hop_group_id;
     }
 
-    /* Sync the route entry */
+    m_bulkContexts.emplace_back();
+    RouteBulkContext &ctx = m_bulkContexts.back();
+    ctx.key = key;
+    ctx.ip_prefix = ipPrefix;
+    ctx.next_hops = nextHops;
+    if (route != nullptr)
+        ctx.old_next_hops = m_nextHopSets.get(route->next_hops);
+
+    /* Queue the route entry */
     sai_unicast_route_entry_t route_entry;
     route_entry.vr_id = gVirtualRouterId;
-    route_entry.destination.addr_family = SAI_IP_ADDR_FAMILY_IPV4;
-    route_entry.destination.addr.ip4 = ipPrefix.getIp().getV4Addr();
-    route_entry.destination.mask.ip4 = ipPrefix.getMask().getV4Addr();
+    copy(route_entry.destination, ipPrefix);
 
     sai_attribute_t route_attr;
     route_attr.id = SAI_ROUTE_ATTR_NEXT_HOP_ID;
@@ -373,18 +1112,28 @@ bool RouteOrch::addRoute(IpPrefix ipPrefix, IpAddresses nextHops)
      * (group) id. The old next hop (group) is then not used and the reference
      * count will decrease by 1.
      */
-    if (it_route == m_syncdRoutes.end())
+    if (route == nullptr)
+        m_routeBulker.create_entry(&ctx.status, &route_entry, 1, &route_attr);
+    else
+        m_routeBulker.set_entry_attribute(&ctx.status, &route_entry, &route_attr);
+
+    return true;
+}
+
+bool RouteOrch::addRoutePost(const RouteBulkContext &ctx)
+{
+    SWSS_LOG_ENTER();
+
+    const IpPrefix &ipPrefix = ctx.ip_prefix;
+    const IpAddresses &nextHops = ctx.next_hops;
+
+    if (ctx.old_next_hops.getSize() == 0)
     {
-        sai_status_t status = sai_route_api->create_route(&route_entry, 1, &route_attr);
-        if (status != SAI_STATUS_SUCCESS)
+        if (ctx.status != SAI_STATUS_SUCCESS)
         {
             SWSS_LOG_ERROR("Failed to create route %s with next hop(s) %s",
                     ipPrefix.to_string().c_str(), nextHops.to_string().c_str());
-            /* Clean up the newly created next hop group entry */
-            if (nextHops.getSize() > 1)
-            {
-                removeNextHopGroup(nextHops);
-            }
+            /* The newly created next hop group entry is cleaned up by the caller */
             return false;
         }
 
@@ -395,8 +1144,7 @@ bool RouteOrch::addRoute(IpPrefix ipPrefix, IpAddresses nextHops)
     }
     else
     {
-        sai_status_t status = sai_route_api->set_route_attribute(&route_entry, &route_attr);
-        if (status != SAI_STATUS_SUCCESS)
+        if (ctx.status != SAI_STATUS_SUCCESS)
         {
             SWSS_LOG_ERROR("Failed to set route %s with next hop(s) %s",
                     ipPrefix.to_string().c_str(), nextHops.to_string().c_str());
@@ -405,58 +1153,71 @@ bool RouteOrch::addRoute(IpPrefix ipPrefix, IpAddresses nextHops)
 
         /* Increase the ref_count for the next hop (group) entry */
         increaseNextHopRefCount(nextHops);
-
-        decreaseNextHopRefCount(it_route->second);
-        if (it_route->second.getSize() > 1
-            && m_syncdNextHopGroups[it_route->second].ref_count == 0)
-        {
-            removeNextHopGroup(it_route->second);
-        }
+        /* The old next hop group is removed by the caller once unreferenced */
+        decreaseNextHopRefCount(ctx.old_next_hops);
         SWSS_LOG_INFO("Set route %s with next hop(s) %s",
                 ipPrefix.to_string().c_str(), nextHops.to_string().c_str());
     }
 
-    m_syncdRoutes[ipPrefix] = nextHops;
+    RouteKey route_key(ipPrefix);
+    RouteEntry *route = m_syncdRoutes.find(route_key);
+    if (route != nullptr)
+    {
+        removeNextHopRoute(*route);
+        m_nextHopSets.release(route->next_hops);
+    }
+    else
+        route = &m_syncdRoutes.insert(route_key);
+
+    route->next_hops = m_nextHopSets.acquire(nextHops);
+    route->generation = m_generation;
+    addNextHopRoute(route_key, *route);
     return true;
 }
 
-bool RouteOrch::removeRoute(IpPrefix ipPrefix)
+void RouteOrch::removeRoute(string key, IpPrefix ipPrefix)
 {
     SWSS_LOG_ENTER();
 
+    m_bulkContexts.emplace_back();
+    RouteBulkContext &ctx = m_bulkContexts.back();
+    ctx.key = key;
+    ctx.ip_prefix = ipPrefix;
+    ctx.old_next_hops = m_nextHopSets.get(m_syncdRoutes.find(RouteKey(ipPrefix))->next_hops);
+
     sai_unicast_route_entry_t route_entry;
     route_entry.vr_id = gVirtualRouterId;
-    route_entry.destination.addr_family = SAI_IP_ADDR_FAMILY_IPV4;
-    route_entry.destination.addr.ip4 = ipPrefix.getIp().getV4Addr();
-    route_entry.destination.mask.ip4 = ipPrefix.getMask().getV4Addr();
+    copy(route_entry.destination, ipPrefix);
 
-    sai_status_t status = sai_route_api->remove_route(&route_entry);
-    if (status != SAI_STATUS_SUCCESS)
+    m_routeBulker.remove_entry(&ctx.status, &route_entry);
+}
+
+bool RouteOrch::removeRoutePost(const RouteBulkContext &ctx)
+{
+    SWSS_LOG_ENTER();
+
+    const IpPrefix &ipPrefix = ctx.ip_prefix;
+
+    if (ctx.status != SAI_STATUS_SUCCESS)
     {
         SWSS_LOG_ERROR("Failed to remove route prefix:%s\n", ipPrefix.to_string().c_str());
         return false;
     }
 
-    /* Remove next hop group entry if ref_count is zero */
-    auto it_route = m_syncdRoutes.find(ipPrefix);
-    if (it_route != m_syncdRoutes.end())
-    {
-        /*
-         * Decrease the reference count only when the route is pointing to a next hop.
-         * Decrease the reference count when the route is pointing to a next hop group,
-         * and check wheather the reference count decreases to zero. If yes, then we need
-         * to remove the next hop group.
-         */
-        decreaseNextHopRefCount(it_route->second);
-        if (it_route->second.getSize() > 1
-            && m_syncdNextHopGroups[it_route->second].ref_count == 0)
-        {
-            removeNextHopGroup(it_route->second);
-        }
-    }
+    /*
+     * Decrease the reference count of the next hop or next hop group the
+     * route is pointing to. A next hop group whose reference count drops
+     * to zero is removed by the caller.
+     */
+    decreaseNextHopRefCount(ctx.old_next_hops);
+
     SWSS_LOG_INFO("Remove route %s with next hop(s) %s",
-            ipPrefix.to_string().c_str(), it_route->second.to_string().c_str());
+            ipPrefix.to_string().c_str(), ctx.old_next_hops.to_string().c_str());
 
-    m_syncdRoutes.erase(ipPrefix);
+    RouteKey route_key(ipPrefix);
+    RouteEntry *route = m_syncdRoutes.find(route_key);
+    removeNextHopRoute(*route);
+    m_nextHopSets.release(route->next_hops);
+    m_syncdRoutes.erase(route_key);
     return true;
 }
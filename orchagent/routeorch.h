@@ -2,66 +2,149 @@
 #define SWSS_ROUTEORCH_H
 
 #include "orch.h"
+#include "bulker.h"
+#include "observer.h"
 #include "intfsorch.h"
 #include "neighorch.h"
+#include "routetable.h"
+#include "workerpool.h"
 
 #include "ipaddress.h"
 #include "ipaddresses.h"
 #include "ipprefix.h"
 
 #include <map>
+#include <deque>
 
 using namespace std;
 using namespace swss;
 
-/* Maximum next hop group number */
-#define NHGRP_MAX_SIZE 128
+/* Next hop group capacity used when the switch does not report it */
+#define DEFAULT_NUMBER_OF_ECMP_GROUPS   128
+#define DEFAULT_ECMP_MEMBERS            64
 
 struct NextHopGroupEntry
 {
     sai_object_id_t     next_hop_group_id;  // next hop group id
     int                 ref_count;          // reference count
+    set<IpAddress>      members;            // next hops programmed in the group
 };
 
+/* RouteBulkContext: a route operation queued in the bulker during a doTask pass */
+struct RouteBulkContext
+{
+    string              key;            // task key, empty for a temporary route
+    IpPrefix            ip_prefix;      // destination network
+    IpAddresses         next_hops;      // next hop IP address(es), empty on removal
+    IpAddresses         old_next_hops;  // programmed next hop IP address(es), if any
+    sai_status_t        status;         // status reported by the bulker
+};
+
+/* Minimum number of route tasks per shard to prepare them in parallel */
+#define ROUTE_PREPARE_SHARD_SIZE    32
+/* Maximum number of threads preparing the route tasks, the orch thread included */
+#define ROUTE_PREPARE_MAX_THREADS   4u
+
+/* ParkedRoute: a route task kept out of the retry sweep */
+struct ParkedRoute
+{
+    KeyOpFieldsValuesTuple  task;           // route task
+    uint32_t                generation;     // resync generation the task was announced in
+};
+
+/* ParkedRouteTable: task key, ParkedRoute */
+typedef map<string, ParkedRoute> ParkedRouteTable;
 /* NextHopGroupTable: next hop group IP addersses, NextHopGroupEntry */
 typedef map<IpAddresses, NextHopGroupEntry> NextHopGroupTable;
-/* RouteTable: destination network, next hop IP address(es) */
-typedef map<IpPrefix, IpAddresses> RouteTable;
+/* NextHopWaiters: next hop IP address, keys of the route tasks waiting for it */
+typedef map<IpAddress, set<string>> NextHopWaiters;
+/* NextHopSetRouteTable: destination networks routed through each next hop set, by handle */
+typedef vector<vector<RouteKey>> NextHopSetRouteTable;
+
+/* RoutePrepared: a route task parsed and compared with the synced route */
+struct RoutePrepared
+{
+    bool                valid;          // the task could be parsed
+    IpPrefix            ip_prefix;      // destination network
+    RouteKey            route_key;      // destination network key
+    IpAddresses         next_hops;      // next hop IP address(es) of a SET
+    string              alias;          // interface alias of a SET
+    RouteEntry         *route;          // synced route, if any
+    bool                duplicate;      // SET with the next hops already synced
+};
 
-class RouteOrch : public Orch
+class RouteOrch : public Orch, public Observer
 {
 public:
     RouteOrch(DBConnector *db, string tableName,
-              PortsOrch *portsOrch, NeighOrch *neighOrch) :
-        Orch(db, tableName),
-        m_portsOrch(portsOrch),
-        m_neighOrch(neighOrch),
-        m_nextHopGroupCount(0),
-        m_resync(false) {};
+              PortsOrch *portsOrch, NeighOrch *neighOrch);
 
     bool hasNextHopGroup(IpAddresses);
 
+    void update(SubjectType, void *);
+
+    void doPendingTask();
+
 private:
     PortsOrch *m_portsOrch;
     NeighOrch *m_neighOrch;
 
     int m_nextHopGroupCount;
+    int m_maxNextHopGroupCount;
+    uint32_t m_maxNextHopGroupMembers;
+    uint32_t m_generation;
     bool m_resync;
 
     RouteTable m_syncdRoutes;
+    NextHopSetTable m_nextHopSets;
     NextHopGroupTable m_syncdNextHopGroups;
 
+    /* Route tasks blocked on unresolved next hops, kept out of the retry sweep */
+    ParkedRouteTable m_blockedRoutes;
+    NextHopWaiters m_nextHopWaiters;
+
+    /* Route tasks installed on a smaller next hop set for lack of groups */
+    ParkedRouteTable m_degradedRoutes;
+
+    /* Reverse index of m_syncdRoutes by next hop set */
+    NextHopSetRouteTable m_nextHopSetRoutes;
+
+    bool blockRoute(KeyOpFieldsValuesTuple &, IpAddresses);
+    void unblockRoute(ParkedRouteTable::iterator);
+    bool degradeRoute(KeyOpFieldsValuesTuple &, IpPrefix, IpAddresses);
+    void promoteRoutes();
+    void validateNextHop(IpAddress);
+    void invalidateNextHop(IpAddress);
+
+    void addNextHopRoute(const RouteKey &, RouteEntry &);
+    void removeNextHopRoute(RouteEntry &);
+    size_t countNextHopRoutes(IpAddress);
+
     void increaseNextHopRefCount(IpAddresses);
     void decreaseNextHopRefCount(IpAddresses);
 
     bool addNextHopGroup(IpAddresses);
     bool removeNextHopGroup(IpAddresses);
-
-    void addTempRoute(IpPrefix, IpAddresses);
-    bool addRoute(IpPrefix, IpAddresses);
-    bool removeRoute(IpPrefix);
+    bool addNextHopGroupMember(NextHopGroupEntry &, IpAddress);
+    bool removeNextHopGroupMember(NextHopGroupEntry &, IpAddress);
+    bool updateNextHopGroup(IpPrefix, IpAddresses);
+
+    RouteBulker m_routeBulker;
+    deque<RouteBulkContext> m_bulkContexts;
+    WorkerPool m_preparePool;
+
+    bool addTempRoute(IpPrefix, IpAddresses);
+    void prepareRoute(const KeyOpFieldsValuesTuple &, RoutePrepared &);
+    void prepareRoutes(Consumer &, vector<RoutePrepared> &);
+    bool addRoute(string, IpPrefix, IpAddresses);
+    bool addRoutePost(const RouteBulkContext &);
+    void removeRoute(string, IpPrefix);
+    bool removeRoutePost(const RouteBulkContext &);
+    void flushRoutes(Consumer &);
+    void removeStaleRoutes(Consumer &);
 
     void doTask(Consumer& consumer);
+    bool isParked(Consumer &consumer, const string &key);
 };
 
 #endif /* SWSS_ROUTEORCH_H */
@@ -0,0 +1,89 @@
+#include "routetable.h"
+
+#include "assert.h"
+
+#include <string.h>
+
+RouteKey::RouteKey(const IpPrefix &ipPrefix) :
+    addr(), reserved(0)
+{
+    ip_addr_t ip = ipPrefix.getIp().getIp();
+
+    family = ip.family;
+    prefix_len = (uint8_t)ipPrefix.getMaskLength();
+
+    if (family == AF_INET)
+        addr[0] = ip.ip_addr.ipv4_addr;
+    else
+        memcpy(addr, ip.ip_addr.ipv6_addr, sizeof(addr));
+}
+
+IpPrefix RouteKey::getIpPrefix() const
+{
+    ip_addr_t ip;
+
+    ip.family = family;
+    if (family == AF_INET)
+        ip.ip_addr.ipv4_addr = addr[0];
+    else
+        memcpy(ip.ip_addr.ipv6_addr, addr, sizeof(addr));
+
+    return IpPrefix(IpAddress(ip).to_string() + "/" + to_string(prefix_len));
+}
+
+NextHopSetId NextHopSetTable::acquire(const IpAddresses &ipAddresses)
+{
+    auto it = m_ids.find(ipAddresses);
+    if (it != m_ids.end())
+    {
+        m_sets[it->second].ref_count++;
+        return it->second;
+    }
+
+    NextHopSetId id;
+    if (!m_freeIds.empty())
+    {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+        m_sets[id].next_hops = ipAddresses;
+    }
+    else
+    {
+        id = (NextHopSetId)m_sets.size();
+        m_sets.push_back({ ipAddresses, 0 });
+    }
+
+    m_sets[id].ref_count = 1;
+    m_ids[ipAddresses] = id;
+    for (auto &it : ipAddresses.getIpAddresses())
+        m_nextHopIds[it].insert(id);
+    return id;
+}
+
+void NextHopSetTable::release(NextHopSetId id)
+{
+    assert(id < m_sets.size() && m_sets[id].ref_count > 0);
+
+    if (--m_sets[id].ref_count > 0)
+        return;
+
+    for (auto &it : m_sets[id].next_hops.getIpAddresses())
+    {
+        auto it_ids = m_nextHopIds.find(it);
+        it_ids->second.erase(id);
+        if (it_ids->second.empty())
+            m_nextHopIds.erase(it_ids);
+    }
+
+    m_ids.erase(m_sets[id].next_hops);
+    m_sets[id].next_hops = IpAddresses();
+    m_freeIds.push_back(id);
+}
+
+const set<NextHopSetId> &NextHopSetTable::getIds(const IpAddress &ipAddress) const
+{
+    static const set<NextHopSetId> empty;
+
+    auto it = m_nextHopIds.find(ipAddress);
+    return it == m_nextHopIds.end() ? empty : it->second;
+}
@@ -0,0 +1,124 @@
+#ifndef SWSS_ROUTETABLE_H
+#define SWSS_ROUTETABLE_H
+
+#include "ipaddress.h"
+#include "ipaddresses.h"
+#include "ipprefix.h"
+
+#include <netinet/in.h>
+
+#include <map>
+#include <set>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+using namespace swss;
+
+/* RouteKey: compact destination network key of a route */
+struct RouteKey
+{
+    uint32_t            addr[4];        // address in network order, IPv4 in addr[0]
+    uint8_t             prefix_len;     // prefix length
+    uint8_t             family;         // AF_INET or AF_INET6
+    uint16_t            reserved;       // always 0
+
+    RouteKey() : addr(), prefix_len(0), family(0), reserved(0) { }
+    explicit RouteKey(const IpPrefix &ipPrefix);
+
+    bool isV4() const { return family == AF_INET; }
+    IpPrefix getIpPrefix() const;
+
+    bool operator==(const RouteKey &o) const
+    {
+        return addr[0] == o.addr[0] && addr[1] == o.addr[1] &&
+               addr[2] == o.addr[2] && addr[3] == o.addr[3] &&
+               prefix_len == o.prefix_len && family == o.family;
+    }
+};
+
+struct RouteKeyHash
+{
+    size_t operator()(const RouteKey &key) const
+    {
+        uint64_t h = ((uint64_t)key.addr[0] << 32 | key.addr[1]) * 0x9e3779b97f4a7c15ULL;
+        h ^= ((uint64_t)key.addr[2] << 32 | key.addr[3]) + (h << 6) + (h >> 2);
+        h ^= key.prefix_len;
+        return (size_t)(h ^ (h >> 29));
+    }
+};
+
+/* NextHopSetId: handle of an interned next hop set */
+typedef uint32_t NextHopSetId;
+
+/*
+ * NextHopSetTable interns the next hop sets of the routes. The routes
+ * sharing the same next hops share one IpAddresses and refer to it with
+ * a 32-bit handle, released once the last route using it is removed.
+ * The handles are also indexed by each next hop of their set.
+ */
+class NextHopSetTable
+{
+public:
+    /* Get the handle of the next hop set and take a reference on it */
+    NextHopSetId acquire(const IpAddresses &ipAddresses);
+    /* Drop a reference on the handle, which may be reused afterwards */
+    void release(NextHopSetId id);
+
+    const IpAddresses &get(NextHopSetId id) const { return m_sets[id].next_hops; }
+    /* Get the handles of the sets containing the next hop */
+    const set<NextHopSetId> &getIds(const IpAddress &ipAddress) const;
+    size_t size() const { return m_ids.size(); }
+
+private:
+    struct NextHopSetEntry
+    {
+        IpAddresses     next_hops;      // next hop IP address(es)
+        uint32_t        ref_count;      // number of routes using the set
+    };
+
+    vector<NextHopSetEntry> m_sets;
+    vector<NextHopSetId> m_freeIds;
+    map<IpAddresses, NextHopSetId> m_ids;
+    map<IpAddress, set<NextHopSetId>> m_nextHopIds;
+};
+
+struct RouteEntry
+{
+    NextHopSetId        next_hops;      // next hop IP address(es)
+    uint32_t            generation;     // resync generation last announced in
+    uint32_t            set_index;      // position in the route list of its next hop set
+};
+
+/* RouteMap: destination network, RouteEntry */
+typedef unordered_map<RouteKey, RouteEntry, RouteKeyHash> RouteMap;
+
+/*
+ * RouteTable keeps the routes of each address family in its own hash
+ * table. An entry is the compact key and the route, in the node the hash
+ * table allocates for it, with no string or IpAddresses of its own.
+ */
+class RouteTable
+{
+public:
+    RouteEntry *find(const RouteKey &key)
+    {
+        RouteMap &routes = getRoutes(key.family);
+        auto it = routes.find(key);
+        return it == routes.end() ? nullptr : &it->second;
+    }
+
+    /* Insert a route, the caller sets its next hops and generation */
+    RouteEntry &insert(const RouteKey &key) { return getRoutes(key.family)[key]; }
+    void erase(const RouteKey &key) { getRoutes(key.family).erase(key); }
+
+    size_t size() const { return m_v4Routes.size() + m_v6Routes.size(); }
+
+    RouteMap &getRoutes(uint8_t family) { return family == AF_INET ? m_v4Routes : m_v6Routes; }
+
+private:
+    RouteMap m_v4Routes;
+    RouteMap m_v6Routes;
+};
+
+#endif /* SWSS_ROUTETABLE_H */
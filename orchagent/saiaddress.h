@@ -0,0 +1,76 @@
+#ifndef SWSS_SAIADDRESS_H
+#define SWSS_SAIADDRESS_H
+
+extern "C" {
+#include "sai.h"
+}
+
+#include "ipaddress.h"
+#include "ipprefix.h"
+
+#include <string.h>
+#include <netinet/in.h>
+
+using namespace swss;
+
+/* Fill a SAI IP address of either family from an IpAddress */
+inline void copy(sai_ip_address_t &dst, const IpAddress &src)
+{
+    ip_addr_t ip = src.getIp();
+
+    if (ip.family == AF_INET)
+    {
+        dst.addr_family = SAI_IP_ADDR_FAMILY_IPV4;
+        dst.addr.ip4 = ip.ip_addr.ipv4_addr;
+    }
+    else
+    {
+        dst.addr_family = SAI_IP_ADDR_FAMILY_IPV6;
+        memcpy(dst.addr.ip6, ip.ip_addr.ipv6_addr, sizeof(dst.addr.ip6));
+    }
+}
+
+/*
+ * Fill a SAI IP prefix of either family from an address and a prefix
+ * length. The address is masked so that the host bits are never passed
+ * down. The mask is computed from the length, without going through the
+ * string based IpPrefix::getMask().
+ */
+inline void copy(sai_ip_prefix_t &dst, const IpAddress &src, int prefixLen)
+{
+    ip_addr_t ip = src.getIp();
+
+    if (ip.family == AF_INET)
+    {
+        uint32_t mask = prefixLen <= 0 ? 0 : htonl(0xFFFFFFFFu << (32 - prefixLen));
+
+        dst.addr_family = SAI_IP_ADDR_FAMILY_IPV4;
+        dst.addr.ip4 = ip.ip_addr.ipv4_addr & mask;
+        dst.mask.ip4 = mask;
+    }
+    else
+    {
+        dst.addr_family = SAI_IP_ADDR_FAMILY_IPV6;
+        for (int i = 0; i < 16; i++)
+        {
+            int bits = prefixLen - i * 8;
+            uint8_t mask = bits >= 8 ? 0xFF : bits <= 0 ? 0 : (uint8_t)(0xFF00 >> bits);
+
+            dst.addr.ip6[i] = ip.ip_addr.ipv6_addr[i] & mask;
+            dst.mask.ip6[i] = mask;
+        }
+    }
+}
+
+inline void copy(sai_ip_prefix_t &dst, const IpPrefix &src)
+{
+    copy(dst, src.getIp(), src.getMaskLength());
+}
+
+/* Fill a SAI IP prefix with the host route of an address */
+inline void copy(sai_ip_prefix_t &dst, const IpAddress &src)
+{
+    copy(dst, src, src.isV4() ? 32 : 128);
+}
+
+#endif /* SWSS_SAIADDRESS_H */
@@ -0,0 +1,252 @@
+#include "saitracer.h"
+
+#include "logger.h"
+
+extern "C" {
+#include "sai.h"
+#include "saistatus.h"
+}
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+extern sai_switch_api_t*            sai_switch_api;
+extern sai_port_api_t*              sai_port_api;
+extern sai_vlan_api_t*              sai_vlan_api;
+extern sai_router_interface_api_t*  sai_router_intfs_api;
+extern sai_hostif_api_t*            sai_hostif_api;
+extern sai_neighbor_api_t*          sai_neighbor_api;
+extern sai_next_hop_api_t*          sai_next_hop_api;
+extern sai_next_hop_group_api_t*    sai_next_hop_group_api;
+extern sai_route_api_t*             sai_route_api;
+extern sai_lag_api_t*               sai_lag_api;
+extern sai_policer_api_t*           sai_policer_api;
+extern sai_tunnel_api_t*            sai_tunnel_api;
+
+/* SAI_TRACED_OPS: API name, API table, API table type, operation */
+#define SAI_TRACED_OPS(X) \
+    X(SWITCH,           switch,         sai_switch_api_t,           initialize_switch)                  \
+    X(SWITCH,           switch,         sai_switch_api_t,           get_switch_attribute)               \
+    X(SWITCH,           switch,         sai_switch_api_t,           set_switch_attribute)               \
+    X(PORT,             port,           sai_port_api_t,             get_port_attribute)                 \
+    X(PORT,             port,           sai_port_api_t,             set_port_attribute)                 \
+    X(VLAN,             vlan,           sai_vlan_api_t,             create_vlan)                        \
+    X(VLAN,             vlan,           sai_vlan_api_t,             remove_vlan)                        \
+    X(VLAN,             vlan,           sai_vlan_api_t,             get_vlan_attribute)                 \
+    X(VLAN,             vlan,           sai_vlan_api_t,             create_vlan_member)                 \
+    X(VLAN,             vlan,           sai_vlan_api_t,             remove_vlan_member)                 \
+    X(ROUTER_INTERFACE, router_intfs,   sai_router_interface_api_t, create_router_interface)            \
+    X(ROUTER_INTERFACE, router_intfs,   sai_router_interface_api_t, remove_router_interface)            \
+    X(HOST_INTERFACE,   hostif,         sai_hostif_api_t,           create_hostif)                      \
+    X(HOST_INTERFACE,   hostif,         sai_hostif_api_t,           create_hostif_trap_group)           \
+    X(HOST_INTERFACE,   hostif,         sai_hostif_api_t,           remove_hostif_trap_group)           \
+    X(HOST_INTERFACE,   hostif,         sai_hostif_api_t,           set_trap_group_attribute)           \
+    X(HOST_INTERFACE,   hostif,         sai_hostif_api_t,           set_trap_attribute)                 \
+    X(NEIGHBOR,         neighbor,       sai_neighbor_api_t,         create_neighbor_entry)              \
+    X(NEIGHBOR,         neighbor,       sai_neighbor_api_t,         remove_neighbor_entry)              \
+    X(NEXT_HOP,         next_hop,       sai_next_hop_api_t,         create_next_hop)                    \
+    X(NEXT_HOP,         next_hop,       sai_next_hop_api_t,         remove_next_hop)                    \
+    X(NEXT_HOP_GROUP,   next_hop_group, sai_next_hop_group_api_t,   create_next_hop_group)              \
+    X(NEXT_HOP_GROUP,   next_hop_group, sai_next_hop_group_api_t,   remove_next_hop_group)              \
+    X(NEXT_HOP_GROUP,   next_hop_group, sai_next_hop_group_api_t,   add_next_hop_to_group)              \
+    X(NEXT_HOP_GROUP,   next_hop_group, sai_next_hop_group_api_t,   remove_next_hop_from_group)         \
+    X(ROUTE,            route,          sai_route_api_t,            create_route)                       \
+    X(ROUTE,            route,          sai_route_api_t,            remove_route)                       \
+    X(ROUTE,            route,          sai_route_api_t,            set_route_attribute)                \
+    X(LAG,              lag,            sai_lag_api_t,              create_lag)                         \
+    X(LAG,              lag,            sai_lag_api_t,              remove_lag)                         \
+    X(LAG,              lag,            sai_lag_api_t,              create_lag_member)                  \
+    X(LAG,              lag,            sai_lag_api_t,              remove_lag_member)                  \
+    X(POLICER,          policer,        sai_policer_api_t,          create_policer)                     \
+    X(POLICER,          policer,        sai_policer_api_t,          remove_policer)                     \
+    X(POLICER,          policer,        sai_policer_api_t,          set_policer_attribute)              \
+    X(TUNNEL,           tunnel,         sai_tunnel_api_t,           create_tunnel)                      \
+    X(TUNNEL,           tunnel,         sai_tunnel_api_t,           remove_tunnel)                      \
+    X(TUNNEL,           tunnel,         sai_tunnel_api_t,           set_tunnel_attribute)               \
+    X(TUNNEL,           tunnel,         sai_tunnel_api_t,           create_tunnel_term_table_entry)     \
+    X(TUNNEL,           tunnel,         sai_tunnel_api_t,           remove_tunnel_term_table_entry)
+
+enum sai_trace_op_t
+{
+#define SAI_TRACE_OP_ENUM(api, table, type, op) SAI_TRACE_##api##_##op,
+    SAI_TRACED_OPS(SAI_TRACE_OP_ENUM)
+#undef SAI_TRACE_OP_ENUM
+    SAI_TRACE_OP_COUNT
+};
+
+static const char *sai_trace_op_names[] =
+{
+#define SAI_TRACE_OP_NAME(api, table, type, op) #api ":" #op,
+    SAI_TRACED_OPS(SAI_TRACE_OP_NAME)
+#undef SAI_TRACE_OP_NAME
+};
+
+/* Upper bounds in microseconds of the call latency buckets */
+static const uint64_t sai_latency_buckets[] = { 10, 100, 1000, 10000, 100000 };
+#define SAI_LATENCY_BUCKETS     (sizeof(sai_latency_buckets) / sizeof(sai_latency_buckets[0]) + 1)
+
+/* Failures are counted per status code down to -SAI_STATUS_BUCKETS, the others together */
+#define SAI_STATUS_BUCKETS      32
+
+/* SaiTraceStats: only updated with relaxed atomics so that callers never block */
+struct SaiTraceStats
+{
+    atomic<uint64_t> calls;                             // calls made
+    atomic<uint64_t> total_us;                          // time spent in the calls
+    atomic<uint64_t> latency[SAI_LATENCY_BUCKETS];      // calls per latency bucket
+    atomic<uint64_t> failures[SAI_STATUS_BUCKETS + 1];  // failed calls per status code
+};
+
+static SaiTraceStats sai_trace_stats[SAI_TRACE_OP_COUNT];
+static bool sai_tracer_installed = false;
+
+static void recordSaiCall(int op, sai_status_t status, uint64_t duration)
+{
+    SaiTraceStats &stats = sai_trace_stats[op];
+
+    size_t i = 0;
+    while (i < SAI_LATENCY_BUCKETS - 1 && duration >= sai_latency_buckets[i])
+        i++;
+
+    stats.calls.fetch_add(1, memory_order_relaxed);
+    stats.total_us.fetch_add(duration, memory_order_relaxed);
+    stats.latency[i].fetch_add(1, memory_order_relaxed);
+
+    if (status != SAI_STATUS_SUCCESS)
+    {
+        size_t code = status < 0 && -status < SAI_STATUS_BUCKETS ? -status : SAI_STATUS_BUCKETS;
+        stats.failures[code].fetch_add(1, memory_order_relaxed);
+    }
+}
+
+/*
+ * SaiTrace holds the original function of one traced operation. The
+ * operation index keeps the instantiations apart when several operations
+ * share the same signature.
+ */
+template <int Op, typename... Args>
+struct SaiTrace
+{
+    static sai_status_t (*original)(Args...);
+
+    static sai_status_t call(Args... args)
+    {
+        auto start = chrono::steady_clock::now();
+        sai_status_t status = original(args...);
+        auto end = chrono::steady_clock::now();
+
+        recordSaiCall(Op, status, chrono::duration_cast<chrono::microseconds>(end - start).count());
+        return status;
+    }
+};
+
+template <int Op, typename... Args>
+sai_status_t (*SaiTrace<Op, Args...>::original)(Args...) = nullptr;
+
+template <int Op, typename... Args>
+static void traceSaiOp(sai_status_t (*&fn)(Args...))
+{
+    if (fn == nullptr)
+        return;
+
+    SaiTrace<Op, Args...>::original = fn;
+    fn = SaiTrace<Op, Args...>::call;
+}
+
+/* The wrapped copies of the API tables, the originals are left untouched */
+static sai_switch_api_t             traced_switch_api;
+static sai_port_api_t               traced_port_api;
+static sai_vlan_api_t               traced_vlan_api;
+static sai_router_interface_api_t   traced_router_intfs_api;
+static sai_hostif_api_t             traced_hostif_api;
+static sai_neighbor_api_t           traced_neighbor_api;
+static sai_next_hop_api_t           traced_next_hop_api;
+static sai_next_hop_group_api_t     traced_next_hop_group_api;
+static sai_route_api_t              traced_route_api;
+static sai_lag_api_t                traced_lag_api;
+static sai_policer_api_t            traced_policer_api;
+static sai_tunnel_api_t             traced_tunnel_api;
+
+void installSaiTracer()
+{
+    SWSS_LOG_ENTER();
+
+    if (sai_tracer_installed)
+        return;
+
+#define SAI_TRACE_COPY_API(table)               \
+    if (sai_##table##_api != nullptr)           \
+    {                                           \
+        traced_##table##_api = *sai_##table##_api; \
+        sai_##table##_api = &traced_##table##_api; \
+    }
+
+    SAI_TRACE_COPY_API(switch);
+    SAI_TRACE_COPY_API(port);
+    SAI_TRACE_COPY_API(vlan);
+    SAI_TRACE_COPY_API(router_intfs);
+    SAI_TRACE_COPY_API(hostif);
+    SAI_TRACE_COPY_API(neighbor);
+    SAI_TRACE_COPY_API(next_hop);
+    SAI_TRACE_COPY_API(next_hop_group);
+    SAI_TRACE_COPY_API(route);
+    SAI_TRACE_COPY_API(lag);
+    SAI_TRACE_COPY_API(policer);
+    SAI_TRACE_COPY_API(tunnel);
+#undef SAI_TRACE_COPY_API
+
+#define SAI_TRACE_WRAP_OP(api, table, type, op) \
+    traceSaiOp<SAI_TRACE_##api##_##op>(traced_##table##_api.op);
+    SAI_TRACED_OPS(SAI_TRACE_WRAP_OP)
+#undef SAI_TRACE_WRAP_OP
+
+    sai_tracer_installed = true;
+
+    SWSS_LOG_NOTICE("Trace %d SAI operations\n", SAI_TRACE_OP_COUNT);
+}
+
+bool isSaiTracerInstalled()
+{
+    return sai_tracer_installed;
+}
+
+void publishSaiTracerStats(Table &table)
+{
+    for (int op = 0; op < SAI_TRACE_OP_COUNT; op++)
+    {
+        SaiTraceStats &stats = sai_trace_stats[op];
+
+        uint64_t calls = stats.calls.load(memory_order_relaxed);
+        if (calls == 0)
+            continue;
+
+        vector<FieldValueTuple> fvs;
+        fvs.push_back(FieldValueTuple("CALLS", to_string(calls)));
+        fvs.push_back(FieldValueTuple("TOTAL_US", to_string(stats.total_us.load(memory_order_relaxed))));
+
+        for (size_t i = 0; i < SAI_LATENCY_BUCKETS; i++)
+        {
+            string field = i < SAI_LATENCY_BUCKETS - 1 ?
+                    "LATENCY_LT_" + to_string(sai_latency_buckets[i]) + "US" :
+                    "LATENCY_GE_" + to_string(sai_latency_buckets[i - 1]) + "US";
+            fvs.push_back(FieldValueTuple(field, to_string(stats.latency[i].load(memory_order_relaxed))));
+        }
+
+        for (size_t i = 1; i <= SAI_STATUS_BUCKETS; i++)
+        {
+            uint64_t failures = stats.failures[i].load(memory_order_relaxed);
+            if (failures == 0)
+                continue;
+
+            string field = i < SAI_STATUS_BUCKETS ?
+                    "FAILED_STATUS_-" + to_string(i) : "FAILED_STATUS_OTHER";
+            fvs.push_back(FieldValueTuple(field, to_string(failures)));
+        }
+
+        table.set(sai_trace_op_names[op], fvs);
+    }
+}
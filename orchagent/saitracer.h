@@ -0,0 +1,22 @@
+#ifndef SWSS_SAITRACER_H
+#define SWSS_SAITRACER_H
+
+#include "table.h"
+
+using namespace swss;
+
+/* COUNTERS_DB table holding the statistics of every traced SAI operation */
+#define COUNTERS_SAI_STATS_TABLE    "SAI_STATS"
+
+/*
+ * Replace the global SAI API pointers with copies of the API tables whose
+ * operations used by orchagent are wrapped to time every call and count
+ * its failures. Must be called right after the API tables are queried.
+ */
+void installSaiTracer();
+bool isSaiTracerInstalled();
+
+/* Write the statistics of every traced SAI operation into table */
+void publishSaiTracerStats(Table &table);
+
+#endif /* SWSS_SAITRACER_H */
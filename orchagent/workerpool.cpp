@@ -0,0 +1,73 @@
+#include "workerpool.h"
+
+WorkerPool::WorkerPool(size_t workers) :
+    m_job(nullptr),
+    m_jobs(0),
+    m_next(0),
+    m_pending(0),
+    m_stop(false)
+{
+    for (size_t i = 0; i < workers; i++)
+        m_workers.push_back(thread(&WorkerPool::work, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+
+    for (auto &worker : m_workers)
+        worker.join();
+}
+
+void WorkerPool::run(size_t jobs, const function<void(size_t)> &job)
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    m_job = &job;
+    m_jobs = jobs;
+    m_next = 0;
+    m_pending = jobs;
+
+    if (!m_workers.empty())
+        m_start.notify_all();
+
+    while (m_next < m_jobs)
+    {
+        size_t i = m_next++;
+        lock.unlock();
+        job(i);
+        lock.lock();
+        m_pending--;
+    }
+
+    m_done.wait(lock, [this]() { return m_pending == 0; });
+    m_job = nullptr;
+}
+
+void WorkerPool::work()
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_start.wait(lock, [this]() { return m_stop || (m_job && m_next < m_jobs); });
+        if (m_stop)
+            return;
+
+        while (m_job && m_next < m_jobs)
+        {
+            const function<void(size_t)> *job = m_job;
+            size_t i = m_next++;
+            lock.unlock();
+            (*job)(i);
+            lock.lock();
+
+            if (--m_pending == 0)
+                m_done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SWSS_WORKERPOOL_H
+#define SWSS_WORKERPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/*
+ * WorkerPool keeps a set of threads for the whole life of its owner and
+ * hands them the jobs of one run() at a time. The thread calling run()
+ * takes jobs as well, and run() returns once every job is done.
+ */
+class WorkerPool
+{
+public:
+    /* Start the given number of worker threads, 0 runs every job in the caller */
+    WorkerPool(size_t workers);
+    ~WorkerPool();
+
+    /* Number of threads running the jobs, the caller included */
+    size_t size() const { return m_workers.size() + 1; }
+
+    /* Run job(0) to job(jobs - 1) and wait for all of them */
+    void run(size_t jobs, const function<void(size_t)> &job);
+
+private:
+    mutex m_mutex;
+    condition_variable m_start;         // signaled when jobs are posted or on stop
+    condition_variable m_done;          // signaled when the last job is done
+    vector<thread> m_workers;
+
+    const function<void(size_t)> *m_job;
+    size_t m_jobs;                      // jobs of the current run
+    size_t m_next;                      // next job to take
+    size_t m_pending;                   // jobs not done yet
+    bool m_stop;
+
+    void work();
+};
+
+#endif /* SWSS_WORKERPOOL_H */
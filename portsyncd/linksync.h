@@ -2,7 +2,7 @@
 #define __LINKSYNC__
 
 #include "dbconnector.h"
-#include "producertable.h"
+#include "common/recordingproducertable.h"
 #include "netmsg.h"
 
 #include <map>
@@ -19,7 +19,7 @@ public:
     virtual void onMsg(int nlmsg_type, struct nl_object *obj);
 
 private:
-    ProducerTable m_portTableProducer, m_vlanTableProducer, m_lagTableProducer;
+    RecordingProducerTable m_portTableProducer, m_vlanTableProducer, m_lagTableProducer;
     Table m_portTableConsumer, m_vlanTableConsumer, m_lagTableConsumer;
 
     std::map<unsigned int, std::string> m_ifindexNameMap;
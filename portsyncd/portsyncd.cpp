@@ -1,8 +1,9 @@
 #include "dbconnector.h"
-#include "select.h"
+#include "common/epollselect.h"
 #include "netdispatcher.h"
 #include "netlink.h"
-#include "producertable.h"
+#include "common/recordingproducertable.h"
+#include "common/recorder.h"
 #include "portsyncd/linksync.h"
 
 #include <getopt.h>
@@ -36,14 +37,15 @@ bool g_init = false;
 
 void usage()
 {
-    cout << "Usage: portsyncd [-p port_config.ini] [-v vlan_interfaces]" << endl;
+    cout << "Usage: portsyncd [-p port_config.ini] [-v vlan_interfaces] [-r record_file]" << endl;
     cout << "       -p port_config.ini: MANDATORY import port lane mapping" << endl;
     cout << "                           default: port_config.ini" << endl;
     cout << "       -v vlan_interfaces: import VLAN interfaces configuration file" << endl;
     cout << "                           default: /etc/network/interfaces.d/vlan_interfaces" << endl;
+    cout << "       -r record_file: record the produced tasks into a record log" << endl;
 }
 
-void handlePortConfigFile(ProducerTable &p, string file);
+void handlePortConfigFile(RecordingProducerTable &p, string file);
 void handleVlanIntfFile(string file);
 
 int main(int argc, char **argv)
@@ -52,7 +54,7 @@ int main(int argc, char **argv)
     string port_config_file = DEFAULT_PORT_CONFIG_FILE;
     string vlan_interfaces_file = DEFAULT_VLAN_INTERFACES_FILE;
 
-    while ((opt = getopt(argc, argv, "p:v:h")) != -1 )
+    while ((opt = getopt(argc, argv, "p:v:r:h")) != -1 )
     {
         switch (opt)
         {
@@ -62,6 +64,14 @@ int main(int argc, char **argv)
         case 'v':
             vlan_interfaces_file.assign(optarg);
             break;
+        case 'r':
+            if (!Recorder::getInstance().open(optarg))
+            {
+                cerr << "Failed to open record file " << optarg << endl;
+                return EXIT_FAILURE;
+            }
+            Recorder::getInstance().closeOnSignal();
+            break;
         case 'h':
             usage();
             return 1;
@@ -72,7 +82,7 @@ int main(int argc, char **argv)
     }
 
     DBConnector db(0, "localhost", 6379, 0);
-    ProducerTable p(&db, APP_PORT_TABLE_NAME);
+    RecordingProducerTable p(&db, APP_PORT_TABLE_NAME);
 
     LinkSync sync(&db);
     NetDispatcher::getInstance().registerMessageHandler(RTM_NEWLINK, &sync);
@@ -81,7 +91,7 @@ int main(int argc, char **argv)
     try
     {
         NetLink netlink;
-        Select s;
+        EpollSelect s;
 
         netlink.registerGroup(RTNLGRP_LINK);
         cout << "Listen to link messages..." << endl;
@@ -96,14 +106,16 @@ int main(int argc, char **argv)
             int tempfd, ret;
             ret = s.select(&temps, &tempfd, 1);
 
-            if (ret == Select::ERROR)
+            if (ret == EpollSelect::ERROR)
             {
                 cerr << "Error had been returned in select" << endl;
                 continue;
             }
 
-            if (ret == Select::TIMEOUT)
+            if (ret == EpollSelect::TIMEOUT)
             {
+                Recorder::getInstance().poll();
+
                 if (!g_init && g_portSet.empty())
                 {
                     /*
@@ -133,7 +145,7 @@ int main(int argc, char **argv)
     return 1;
 }
 
-void handlePortConfigFile(ProducerTable &p, string file)
+void handlePortConfigFile(RecordingProducerTable &p, string file)
 {
     cout << "Read port configuration file..." << endl;
 
@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <iostream>
+#include <map>
+#include <set>
+#include <chrono>
+#include <thread>
+#include "logger.h"
+#include "dbconnector.h"
+#include "producertable.h"
+#include "common/recorder.h"
+
+#include <getopt.h>
+
+using namespace std;
+using namespace swss;
+
+int db_port                          = 6379;
+const char* const hostname           = "localhost";
+
+void usage(char **argv)
+{
+    cout << "Usage: " << argv[0] << " [-s speed] [-d db] [-t table]... record_file" << endl;
+    cout << "    -s speed: replay speed, 1 at the recorded pace, N N times faster," << endl;
+    cout << "              0 as fast as possible (default 1)" << endl;
+    cout << "    -d db: database to replay into (default " << APPL_DB << ")" << endl;
+    cout << "    -t table: only replay this table, may be repeated" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    double speed = 1;
+    int db = APPL_DB;
+    set<string> tables;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:d:t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            speed = atof(optarg);
+            break;
+        case 'd':
+            db = atoi(optarg);
+            break;
+        case 't':
+            tables.insert(optarg);
+            break;
+        case 'h':
+            usage(argv);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1 || speed < 0)
+    {
+        usage(argv);
+        return EXIT_FAILURE;
+    }
+
+    RecordReader reader;
+    if (!reader.open(argv[optind]))
+    {
+        cerr << "Failed to open record log " << argv[optind] << endl;
+        return EXIT_FAILURE;
+    }
+
+    DBConnector dbc(db, hostname, db_port, 0);
+    map<string, ProducerTable *> producers;
+
+    RecordEntry entry;
+    uint64_t first = 0;
+    uint64_t count = 0;
+    auto start = chrono::steady_clock::now();
+
+    while (reader.next(entry))
+    {
+        if (!tables.empty() && tables.find(entry.table) == tables.end())
+            continue;
+
+        if (count == 0)
+            first = entry.time;
+
+        /* Keep the recorded spacing of the tasks, scaled by the speed */
+        if (speed > 0)
+        {
+            auto due = start + chrono::microseconds((uint64_t)((entry.time - first) / speed));
+            this_thread::sleep_until(due);
+        }
+
+        auto it = producers.find(entry.table);
+        if (it == producers.end())
+            it = producers.insert(make_pair(entry.table, new ProducerTable(&dbc, entry.table))).first;
+
+        if (kfvOp(entry.kco) == DEL_COMMAND)
+            it->second->del(kfvKey(entry.kco));
+        else
+            it->second->set(kfvKey(entry.kco), kfvFieldsValues(entry.kco));
+
+        count++;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Replayed " << count << " tasks in " << seconds << " seconds" << endl;
+
+    for (auto &p : producers)
+        delete p.second;
+
+    if (reader.isCorrupt())
+    {
+        cerr << "Stopped on a truncated or corrupt record in " << argv[optind] << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
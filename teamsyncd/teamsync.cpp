@@ -16,7 +16,7 @@ using namespace swss;
 /* Taken from drivers/net/team/team.c */
 #define TEAM_DRV_NAME "team"
 
-TeamSync::TeamSync(DBConnector *db, Select *select) :
+TeamSync::TeamSync(DBConnector *db, EpollSelect *select) :
     m_select(select),
     m_lagTable(db, APP_LAG_TABLE_NAME)
 {
@@ -7,7 +7,7 @@
 #include "dbconnector.h"
 #include "producertable.h"
 #include "selectable.h"
-#include "select.h"
+#include "common/epollselect.h"
 #include "netmsg.h"
 #include <team.h>
 
@@ -16,7 +16,7 @@ namespace swss {
 class TeamSync : public NetMsg
 {
 public:
-    TeamSync(DBConnector *db, Select *select);
+    TeamSync(DBConnector *db, EpollSelect *select);
 
     /*
      * Listens to RTM_NEWLINK and RTM_DELLINK to undestand if there is a new
@@ -55,7 +55,7 @@ protected:
     void removeLag(const std::string &lagName);
 
 private:
-    Select *m_select;
+    EpollSelect *m_select;
     ProducerTable m_lagTable;
     std::map<std::string, std::shared_ptr<TeamPortSync> > m_teamPorts;
 };
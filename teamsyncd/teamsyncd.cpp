@@ -1,7 +1,7 @@
 #include <iostream>
 #include <team.h>
 #include "logger.h"
-#include "select.h"
+#include "common/epollselect.h"
 #include "netdispatcher.h"
 #include "netlink.h"
 #include "teamsync.h"
@@ -12,7 +12,7 @@ using namespace swss;
 int main(int argc, char **argv)
 {
     DBConnector db(APPL_DB, "localhost", 6379, 0);
-    Select s;
+    EpollSelect s;
     TeamSync sync(&db, &s);
 
     NetDispatcher::getInstance().registerMessageHandler(RTM_NEWLINK, &sync);